@@ -2,7 +2,7 @@
 set -e
 
 SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
-SOURCE_FOLDERS="source/include source/lib source/test/error_testing source/test/unit test_package"
+SOURCE_FOLDERS="source/include source/lib source/test/error_testing source/test/unit source/tools test_package"
 
 if [ -z "$CLANG_FORMAT" ]; then
     CLANG_FORMAT=clang-format-7
@@ -1,10 +1,17 @@
 #ifndef DEV_NEW_HPP
 #define DEV_NEW_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <boost/scope_exit.hpp>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <limits>
 #include <new>
+#include <vector>
 
 namespace dev_new {
 
@@ -16,6 +23,28 @@ std::uint64_t live_allocations() noexcept;
 std::uint64_t max_allocated_size() noexcept;
 std::uint64_t allocated_size() noexcept;
 
+/// Allocation statistics (e.g. of a memory resource or of a tag).
+struct allocation_statistics {
+    std::uint64_t total_allocations;
+    std::uint64_t live_allocations;
+    std::uint64_t max_allocated_size;
+    std::uint64_t allocated_size;
+};
+
+/// Allocation counters of a single thread.
+struct allocation_counters {
+    std::uint64_t allocations;
+    std::uint64_t deallocations;
+    std::uint64_t allocated_size;
+    std::uint64_t deallocated_size;
+    std::uint64_t max_allocation_size;
+};
+
+/// Returns the allocation counters of the calling thread.
+/// The counters are monotonic (except for `max_allocation_size`, which is the largest single allocation made by the
+/// thread so far); the difference between two readings gives the allocations made by the code run in between.
+allocation_counters thread_allocation_counters() noexcept;
+
 /// Sets the number of allocations and/or error points until an out-of-memory condition will be simulated.
 /// Once the simulated out-of-memory condition is reached, subsequent allocations will fail if they would lead to
 /// allocating more memory than what was allocated when the condition was reached.
@@ -29,10 +58,15 @@ void pause_error_testing() noexcept;
 void resume_error_testing() noexcept;
 // \}
 
+/// Returns true if error testing is set and not paused (i.e. allocations and error points may raise errors).
+bool is_error_testing() noexcept;
+
 /// Defines an error point.
 /// This call behaves as if allocating memory some memory and failing if we are in the simulated out-of-memory
 /// condition.
+/// The nothrow overload returns false instead of throwing std::bad_alloc.
 void error_point();
+bool error_point(std::nothrow_t const & /*unused*/) noexcept;
 
 /// Raw allocation and deallocation.
 // \{
@@ -41,12 +75,613 @@ void *allocate(std::size_t count);
 void deallocate(void *ptr) noexcept;
 // \}
 
+/// Batch allocation and deallocation.
+/// A batch allocates n blocks of count bytes (stored in ptrs) or deallocates n pointers under a single lock.
+/// Each allocation of a batch is an error point, in the order of the pointers. If one of them fails, the allocations
+/// already made by the batch are deallocated before reporting the failure (std::bad_alloc or false).
+// \{
+bool allocate_batch(std::size_t count, std::size_t n, void **ptrs, std::nothrow_t const & /*unused*/) noexcept;
+void allocate_batch(std::size_t count, std::size_t n, void **ptrs);
+void deallocate_batch(void *const *ptrs, std::size_t n) noexcept;
+// \}
+
+/// Large allocations.
+/// On POSIX systems, the allocations of at least the large allocation threshold (by default
+/// `default_large_allocation_threshold` bytes) are mapped directly from the system, with the allocation header in the
+/// first page, and tracked separately from the other allocations. When deallocated, their mapping is either unmapped
+/// or, without its pages, kept in a small cache of mappings for reuse.
+// \{
+std::size_t const default_large_allocation_threshold = 1U << 20U;
+void set_large_allocation_threshold(std::size_t threshold) noexcept;
+std::size_t get_large_allocation_threshold() noexcept;
+
+struct large_allocation_counters {
+    std::uint64_t live_allocations;
+    /// Size of the memory mappings (of the live allocations and of the cached mappings).
+    std::uint64_t mapped_size;
+    std::uint64_t cached_mappings;
+    /// Number of memory mappings created and reused.
+    std::uint64_t mappings;
+    std::uint64_t reused_mappings;
+};
+
+large_allocation_counters large_allocation_statistics() noexcept;
+// \}
+
+/// Deferred (remote) deallocation counters.
+/// A deallocation that would have to wait for the allocator lock (typically a free made by a thread while another one
+/// is allocating) is deferred: the pointer is pushed on a lock-free list that is drained in batches by the next thread
+/// acquiring the lock. The allocation statistics are up to date as soon as the lock is acquired.
+struct remote_free_counters {
+    std::uint64_t remote_frees;
+    std::uint64_t drained_batches;
+    std::uint64_t max_batch_size;
+};
+
+remote_free_counters remote_free_statistics() noexcept;
+
+/// Allocator lock counters.
+/// An acquisition is contended if the lock was held by another thread, in which case its wait time is measured.
+struct lock_counters {
+    std::uint64_t acquisitions;
+    std::uint64_t contended_acquisitions;
+    std::uint64_t wait_nanoseconds;
+};
+
+lock_counters lock_statistics() noexcept;
+
+/// Handler allocation and deallocation.
+/// Allocations of handler-sized blocks (up to `max_recycled_handler_size` bytes) reuse memory blocks kept in per-thread
+/// recycling slots. A recycled allocation is still an error point and is included in the allocation statistics, only
+/// the underlying memory block is reused. The deallocation must be given the same size as the allocation.
+// \{
+std::size_t const max_recycled_handler_size = 1024;
+void *allocate_handler(std::size_t count);
+void deallocate_handler(void *ptr, std::size_t count) noexcept;
+// \}
+
+/// Handler allocation counters.
+struct handler_recycling_counters {
+    std::uint64_t allocations;
+    std::uint64_t recycled_allocations;
+    std::uint64_t released_blocks;
+};
+
+/// Returns the handler allocation counters (of all the threads).
+/// `allocations - recycled_allocations` is the number of memory blocks actually allocated for handlers and
+/// `released_blocks` is the number of blocks freed because the recycling slots of a size class were full.
+handler_recycling_counters handler_allocation_counters() noexcept;
+
+/// Allocation categories.
+/// While a category scope is active, the allocations made by the current thread are attributed to its category (the
+/// innermost scope wins). The category name must have static storage duration (e.g. a string literal). At most
+/// `max_categories` categories are tracked; the allocations of the categories created after that are attributed to a
+/// shared overflow category.
+// \{
+std::size_t const max_categories = 256;
+
+class category_scope {
+  public:
+    explicit category_scope(char const *name) noexcept;
+    ~category_scope();
+
+    category_scope(category_scope const & /*unused*/) = delete;
+    category_scope(category_scope && /*unused*/) = delete;
+    category_scope &operator=(category_scope const & /*unused*/) = delete;
+    category_scope &operator=(category_scope && /*unused*/) = delete;
+};
+
+struct category_statistics {
+    char const *name;
+    std::uint64_t total_allocations;
+    std::uint64_t total_deallocations;
+    /// Live and peak allocated size.
+    std::uint64_t allocated_size;
+    std::uint64_t max_allocated_size;
+    /// Total size allocated (churn).
+    std::uint64_t total_allocated_size;
+};
+
+/// Returns the statistics of the categories that had allocations.
+/// The allocations made outside any category scope are reported under the "(none)" category.
+std::vector<category_statistics> categories_statistics();
+
+/// Prints the statistics of the categories, the categories with the highest churn first.
+void print_category_report(std::FILE *file);
+// \}
+
+/// Operation attribution.
+/// An operation attribution is created for an operation (e.g. an asynchronous operation, see dev_new_asio.hpp). While
+/// an operation scope is active, the allocations made by the current thread are charged to its operation (the
+/// innermost scope wins) and, as long as the operation attribution exists, their deallocations are credited back to
+/// it. When the operation attribution is destroyed, its final statistics are passed to the operation observer.
+/// At most `max_operations` operations are attributed at the same time; the operations created after that are not.
+// \{
+std::size_t const max_operations = 4096;
+
+struct operation_statistics {
+    std::uint64_t total_allocations;
+    std::uint64_t total_allocated_size;
+    /// Live and peak allocated size.
+    std::uint64_t allocated_size;
+    std::uint64_t max_allocated_size;
+};
+
+class operation_attribution {
+  public:
+    /// The name must have static storage duration (e.g. a string literal).
+    explicit operation_attribution(char const *name) noexcept;
+    ~operation_attribution();
+
+    operation_attribution(operation_attribution const & /*unused*/) = delete;
+    operation_attribution(operation_attribution && /*unused*/) = delete;
+    operation_attribution &operator=(operation_attribution const & /*unused*/) = delete;
+    operation_attribution &operator=(operation_attribution && /*unused*/) = delete;
+
+    char const *name() const noexcept { return m_name; }
+    operation_statistics statistics() const noexcept;
+
+  private:
+    friend class operation_scope;
+
+    char const *m_name;
+    std::uint32_t m_id;
+};
+
+class operation_scope {
+  public:
+    explicit operation_scope(operation_attribution const &operation) noexcept;
+    ~operation_scope();
+
+    operation_scope(operation_scope const & /*unused*/) = delete;
+    operation_scope(operation_scope && /*unused*/) = delete;
+    operation_scope &operator=(operation_scope const & /*unused*/) = delete;
+    operation_scope &operator=(operation_scope && /*unused*/) = delete;
+
+  private:
+    std::uint32_t m_previous;
+};
+
+/// Called with the final statistics of each completed operation (e.g. to report the memory hogs).
+using operation_observer = void (*)(char const *name, operation_statistics const &statistics);
+void set_operation_observer(operation_observer observer) noexcept;
+
+/// Prints the statistics of an operation (can be used as an operation observer printing to stderr).
+void print_operation_statistics(char const *name, operation_statistics const &statistics);
+// \}
+
+namespace detail {
+class arena;
+} // namespace detail
+
+/// Arena (region) scopes.
+/// While an arena scope is active, the allocations made by the current thread (except the large and the batch
+/// allocations) are carved from a bump-pointer region owned by the innermost scope. They are error points and are
+/// accounted as usual. Deallocating one of them only checks that it is an allocation of a region and updates the
+/// accounting: the memory of the region is released in one go at the end of the scope.
+/// If allocations are still live at the end of the scope, the region is kept until they are deallocated. These scopes
+/// are counted (see arena_leftover_statistics()) and the first one is reported on stderr.
+/// If the region can't be created, the scope has no effect.
+// \{
+struct arena_counters {
+    std::uint64_t allocations;
+    /// Bytes allocated in the region and bytes of the memory blocks of the region.
+    std::uint64_t allocated_size;
+    std::uint64_t reserved_size;
+    std::uint64_t blocks;
+};
+
+class arena_scope {
+  public:
+    static std::size_t const default_block_size = 64U * 1024U;
+
+    explicit arena_scope(std::size_t block_size = default_block_size) noexcept;
+    ~arena_scope();
+
+    arena_scope(arena_scope const & /*unused*/) = delete;
+    arena_scope(arena_scope && /*unused*/) = delete;
+    arena_scope &operator=(arena_scope const & /*unused*/) = delete;
+    arena_scope &operator=(arena_scope && /*unused*/) = delete;
+
+    arena_counters statistics() const noexcept;
+
+  private:
+    detail::arena *m_arena;
+    detail::arena *m_previous;
+};
+
+/// Arena scopes that ended with live allocations.
+struct arena_leftover_counters {
+    std::uint64_t scopes;
+    /// Allocations still live at the end of these scopes and their size.
+    std::uint64_t allocations;
+    std::uint64_t allocated_size;
+    /// Regions kept until their last allocation is deallocated.
+    std::uint64_t kept_regions;
+};
+arena_leftover_counters arena_leftover_statistics() noexcept;
+// \}
+
 /// Checks that a pointer has been allocated by this allocator.
 /// Throws an error if the test fails.
 void check_allocation(void *ptr);
 /// Checks that a pointer has been allocated by this allocator.
 bool check_allocation(void *ptr, std::nothrow_t const & /*unused*/) noexcept;
 
+/// Returns the call site (return address in the calling code) of a live allocation.
+/// Returns nullptr if the pointer is not a live allocation or if the library is built without stack capture.
+void const *allocation_site(void *ptr) noexcept;
+
+/// Compile-time features of the library.
+/// They are selected by the DEV_NEW_TRACKING, DEV_NEW_ERROR_INJECTION, DEV_NEW_STATISTICS, DEV_NEW_STACK_CAPTURE and
+/// DEV_NEW_FILL_PATTERNS compile definitions of the library (see the dev_new, dev_new_stats_only and dev_new_full
+/// targets); a disabled feature doesn't cost anything at runtime.
+struct feature_set {
+    /// The live allocations are tracked (check_allocation() validates only the allocation header otherwise).
+    bool tracking;
+    /// Allocations and error points simulate out-of-memory errors while error testing.
+    bool error_injection;
+    /// The per-thread and per-category statistics are collected.
+    bool statistics;
+    /// The call site of each allocation is recorded.
+    bool stack_capture;
+    /// New memory is filled with 0xCD and freed memory with 0xDD.
+    bool fill_patterns;
+    /// The lifetimes of the allocations are recorded (DEV_NEW_LIFETIMES).
+    bool lifetimes;
+};
+feature_set features() noexcept;
+
+/// Runtime modes.
+/// The mode is selected by the DEV_NEW_OPTIONS environment variable, which is read once before the first allocation.
+/// It holds options separated by commas or spaces:
+/// - `passthrough`, `stats`, `full` or `error_testing` (or `mode=<mode>`): selects the mode (default: error_testing)
+/// - `large_threshold=<bytes>`: sets the large allocation threshold (see set_large_allocation_threshold())
+/// - `error_countdown=<count>`: starts error testing with the given countdown (see set_error_countdown()), in the
+///   error_testing mode only
+/// - `self_profile`: enables self profiling and prints its report to stderr at exit (see self_profile())
+/// - `delay=<nanoseconds>`: delays every allocation (see set_latency_injection())
+/// Invalid options (e.g. an unknown mode or a value that is not a decimal number) are reported on stderr and ignored,
+/// as is an error countdown given in another mode than error_testing.
+/// All the modes honour the large_threshold, self_profile and delay options (in passthrough mode, for the allocations
+/// of this library only). The modes only restrict the features the library is built with (see features()).
+enum class runtime_mode {
+    /// The global operators new and delete only call malloc and free (their allocations are not tracked).
+    /// The allocation functions of this library (e.g. allocate() or the allocators) are not affected.
+    passthrough,
+    /// Statistics only: the allocations are not tracked and error testing is disabled (error_countdown is ignored).
+    stats,
+    /// Tracking and statistics, error testing is disabled (error_countdown is ignored).
+    full,
+    /// Tracking, statistics and error testing (the only mode that honours error_countdown).
+    error_testing
+};
+runtime_mode get_runtime_mode() noexcept;
+
+/// Allocation lifetimes.
+/// With the lifetimes feature (see features()), each allocation records its allocation time and the allocation clock
+/// (the number of allocations made so far). When it is freed, its lifetime, in nanoseconds and in allocation clock
+/// ticks, is added to log-scale histograms of its size class and of its call site (see allocation_site()).
+// \{
+std::size_t const lifetime_buckets = 48;
+
+/// Log-scale histogram: bucket 0 counts the zero lifetimes and bucket i the lifetimes in [2^(i-1), 2^i) (the last
+/// bucket also counts the longer lifetimes).
+using lifetime_histogram = std::array<std::uint64_t, lifetime_buckets>;
+
+struct lifetime_statistics {
+    std::uint64_t deallocations;
+    lifetime_histogram nanoseconds;
+    lifetime_histogram ticks;
+};
+
+struct site_lifetime_statistics {
+    /// The unknown site (nullptr) gets the lifetimes when the call sites are not captured or too many.
+    void const *site;
+    lifetime_statistics lifetimes;
+};
+
+/// Returns the lifetimes of the size classes (indexed by the bit width of the allocation size).
+std::vector<lifetime_statistics> size_class_lifetimes();
+/// Returns the lifetimes of the call sites with deallocations.
+std::vector<site_lifetime_statistics> site_lifetimes();
+
+/// Prints the call sites whose allocations are almost always short-lived (e.g. freed within the same request or
+/// handler), the candidates for arenas or object pools.
+/// A site is reported if at least min_fraction of its allocations were freed within max_ticks allocations.
+void print_lifetime_report(std::FILE *file, std::uint64_t max_ticks = 1024, double min_fraction = 0.9);
+// \}
+
+/// Growth steps (missing reserve detection).
+/// With stack capture, a growth step is counted when a thread frees a block right before or right after allocating a
+/// block 1.5 to 2.5 times larger from the same call site (i.e. with no other allocation or deallocation of the thread
+/// in between), like a vector or a string growing one geometric step at a time (the new block is allocated before the
+/// old one is freed) or a reallocation (the other way around). The old block size is counted as copied.
+// \{
+struct growth_site {
+    /// The unknown site (nullptr) gets the steps of the sites that don't fit in the table.
+    void const *site;
+    std::uint64_t growth_steps;
+    std::uint64_t copied_size;
+    /// The largest block allocated by a growth step.
+    std::uint64_t max_size;
+};
+
+/// Returns the call sites with growth steps, the most copied size first.
+std::vector<growth_site> growth_sites();
+/// Prints the call sites where a reserve() would save the most copies.
+void print_growth_report(std::FILE *file, std::size_t max_sites = 20);
+// \}
+
+/// Statistics publishing.
+/// publish_statistics() starts a thread that periodically publishes the allocation counters, the categories with the
+/// highest churn and the call sites with the most deallocations (with the lifetimes feature) to the shared memory
+/// segment /dev/shm/dev_new.<pid> (see dev_new_stats_segment.hpp), which the dev_new_top tool shows. Reading the
+/// segment never blocks the process and the publishing thread doesn't allocate.
+/// Returns false if the segment could not be created (always on platforms other than Linux).
+// \{
+bool publish_statistics(unsigned interval_milliseconds = 500);
+/// Stops the publishing thread and removes the segment.
+void stop_publishing_statistics();
+// \}
+
+/// Leak detection.
+/// find_leaks() runs a conservative reachability scan of the live allocations (with tracking): every aligned word of
+/// the roots and of the reachable allocations that points into a live allocation makes it reachable. The roots are the
+/// stack, the registers and the thread-local storage of the calling thread, the data and bss sections of the loaded
+/// modules and the allocations of the arena scopes. The live allocations that can't be reached are leaked.
+/// The stacks and the thread-local storage of the other threads can't be scanned, so the scan is only run when the
+/// calling thread is the only thread of the process (e.g. at the end of a test, once the thread pools are joined, the
+/// allocation observers unregistered and the statistics publishing stopped): otherwise the report is marked
+/// incomplete and has no leaks. Allocations are blocked while scanning.
+/// Linux only (the report is empty and incomplete on the other platforms).
+// \{
+struct leak_site {
+    /// nullptr when the call sites are not captured.
+    void const *site;
+    std::uint64_t allocations;
+    std::uint64_t size;
+};
+
+struct leak_report {
+    /// false if the scan was not run.
+    bool complete;
+    /// Threads of the process other than the calling one (the scan is not run if there are any).
+    unsigned other_threads;
+    std::uint64_t live_allocations;
+    std::uint64_t leaked_allocations;
+    std::uint64_t leaked_size;
+    /// Bytes of the roots and of the reachable allocations scanned.
+    std::uint64_t scanned_size;
+    /// Threads that marked the reachable allocations.
+    unsigned threads;
+    /// The sites with the most leaked bytes first.
+    std::vector<leak_site> sites;
+};
+
+/// Finds the leaked allocations, marking the reachable allocations with thread_count threads (0 picks a count from
+/// the number of live allocations and the hardware concurrency).
+/// Throws std::bad_alloc if the scan could not allocate its buffers.
+leak_report find_leaks(unsigned thread_count = 0);
+void print_leak_report(std::FILE *file, leak_report const &report);
+// \}
+
+/// Heap snapshots.
+/// snapshot() copies the live tracked allocations (with tracking), including the ones made in arena scopes, to an array
+/// sorted by address and diff() reports the allocations made and not freed between two snapshots, grouped by call site
+/// and category (e.g. to find a steady growth by taking a snapshot every N iterations of a soak test, in arena scopes
+/// or not). An allocation is identified by its address, size, call site and category, so an address freed and reused by
+/// the same site with the same size and category between the snapshots is not seen.
+// \{
+struct snapshot_allocation {
+    void const *ptr;
+    std::size_t size;
+    /// nullptr when the call sites are not captured.
+    void const *site;
+    std::uint16_t category;
+};
+
+struct heap_snapshot {
+    /// Sorted by address.
+    std::vector<snapshot_allocation> allocations;
+    /// Total allocations when the snapshot was taken.
+    std::uint64_t total_allocations;
+};
+
+struct snapshot_site_growth {
+    void const *site;
+    char const *category;
+    std::uint64_t allocations;
+    std::uint64_t size;
+};
+
+struct snapshot_diff {
+    /// Allocations made and not freed between the snapshots.
+    std::uint64_t allocations;
+    std::uint64_t size;
+    /// Allocations of the first snapshot freed between the snapshots.
+    std::uint64_t freed_allocations;
+    std::uint64_t freed_size;
+    /// The sites and categories with the most bytes allocated and not freed first.
+    std::vector<snapshot_site_growth> sites;
+};
+
+heap_snapshot snapshot();
+snapshot_diff diff(heap_snapshot const &before, heap_snapshot const &after);
+void print_snapshot_diff(std::FILE *file, snapshot_diff const &diff);
+// \}
+
+/// Memory overhead.
+/// The memory used by the allocator on top of the allocated bytes, sampled together with the process memory.
+// \{
+struct overhead_counters {
+    /// Bytes of the live allocations (see allocated_size()).
+    std::uint64_t allocated_size;
+    /// Allocation headers of the live allocations.
+    std::uint64_t header_size;
+    /// Pointer tables, per-thread category tables, arena regions and the memory manager itself.
+    std::uint64_t metadata_size;
+    /// Unused bytes of the memory blocks of the live allocations: the slack of the malloc blocks (with tracking, on
+    /// Linux, measured by malloc_usable_size()), of the large allocation mappings (cached mappings included) and of
+    /// the arena regions.
+    std::uint64_t slack_size;
+    /// Resident and virtual size of the process (from /proc/self/statm, 0 on the other platforms).
+    std::uint64_t resident_size;
+    std::uint64_t virtual_size;
+};
+
+overhead_counters overhead_statistics() noexcept;
+void print_overhead_report(std::FILE *file);
+// \}
+
+/// Self profiling.
+/// While self profiling is enabled, the latencies of the allocator operations are added to log-linear histograms of
+/// time stamp counter ticks (steady clock nanoseconds on the platforms without one), the contended lock waits to a
+/// histogram of nanoseconds and the probe lengths of the pointer table lookups to a histogram.
+/// The latency of an operation includes its lock wait.
+// \{
+enum class profiled_operation { allocate, deallocate, check_allocation, error_point };
+std::size_t const profiled_operations = 4;
+std::size_t const latency_buckets = 252;
+std::size_t const probe_length_buckets = 32;
+
+/// Log-linear histogram: the values below 8 have a bucket each and each larger power of 2 is split in 4 buckets.
+struct latency_histogram {
+    std::uint64_t count;
+    std::uint64_t total;
+    std::uint64_t max;
+    std::array<std::uint64_t, latency_buckets> buckets;
+};
+
+/// Returns the smallest value counted by a bucket of a latency histogram.
+std::uint64_t latency_bucket_lower_bound(std::size_t bucket) noexcept;
+/// Returns the lower bound of the bucket of a percentile (e.g. 0.99) of a latency histogram.
+std::uint64_t latency_percentile(latency_histogram const &histogram, double fraction) noexcept;
+
+struct self_profile_statistics {
+    /// Latencies in ticks, indexed by profiled_operation.
+    std::array<latency_histogram, profiled_operations> operations;
+    /// Ticks per nanosecond, measured since self profiling was enabled (1 without a time stamp counter).
+    double ticks_per_nanosecond;
+    latency_histogram lock_wait_nanoseconds;
+    /// Number of lookups by probe length (number of slots visited, the last bucket also counts the longer probes).
+    std::array<std::uint64_t, probe_length_buckets> probe_lengths;
+};
+
+void set_self_profiling(bool enabled) noexcept;
+bool is_self_profiling() noexcept;
+self_profile_statistics self_profile() noexcept;
+void print_self_profile(std::FILE *file);
+// \}
+
+/// Latency histogram updated without lock (e.g. the handler latencies recorded by bind_latency()).
+class latency_recorder {
+  public:
+    constexpr latency_recorder() noexcept = default;
+
+    void record(std::uint64_t value) noexcept;
+    latency_histogram histogram() const noexcept;
+
+  private:
+    std::atomic<std::uint64_t> m_count{};
+    std::atomic<std::uint64_t> m_total{};
+    std::atomic<std::uint64_t> m_max{};
+    std::array<std::atomic<std::uint64_t>, latency_buckets> m_buckets{};
+};
+
+/// Prints the count, the mean, the usual percentiles and the maximum of a latency histogram of nanoseconds.
+void print_latency_percentiles(std::FILE *file, char const *name, latency_histogram const &histogram);
+
+/// Latency injection.
+/// While a latency injection policy is set, the selected allocations are delayed before they take the allocator
+/// lock, like the allocations made during page fault storms or with a contended system allocator. It shows how the
+/// latency sensitive code (e.g. the timeouts of asynchronous operations) copes with a slow allocator. The delays
+/// shorter than 100 microseconds are busy waits, the longer ones sleep.
+// \{
+enum class delay_distribution {
+    /// Every delay is max_delay_nanoseconds.
+    fixed,
+    /// The delays are uniformly distributed in [0, max_delay_nanoseconds].
+    uniform,
+    /// The delays follow a recorded histogram of nanoseconds (e.g. allocation latencies measured in production).
+    recorded
+};
+
+struct latency_injection_policy {
+    delay_distribution distribution;
+    std::uint64_t max_delay_nanoseconds;
+    /// Seed of the random delays.
+    std::uint64_t seed;
+    /// One allocation out of period is delayed (0 or 1 delays all of them).
+    std::uint64_t period;
+    /// Only the allocations of at least min_size bytes are delayed.
+    std::size_t min_size;
+    latency_histogram recorded;
+};
+
+struct latency_injection_counters {
+    std::uint64_t delayed_allocations;
+    std::uint64_t total_delay_nanoseconds;
+    std::uint64_t max_delay_nanoseconds;
+};
+
+/// Sets the policy and resets the counters.
+void set_latency_injection(latency_injection_policy const &policy) noexcept;
+void clear_latency_injection() noexcept;
+latency_injection_counters latency_injection_statistics() noexcept;
+// \}
+
+/// Allocation events.
+/// While an observer is registered, the allocator publishes its events to a ring buffer of the allocating thread (an
+/// enqueue, without lock or allocation) and a consumer thread delivers them to the observers. The events published
+/// while a ring is full are dropped. The allocations made by the observers (and by the consumer thread) don't publish
+/// events.
+// \{
+enum class allocation_event_type : std::uint8_t {
+    allocate,
+    /// Published by the thread that completed the deallocation (for remote frees, the next one to take the lock).
+    deallocate,
+    /// An allocation failed by error testing (see error_point()).
+    error_injected,
+    /// The allocated size reached a new peak (published each time the peak grows by at least 1/16).
+    peak_reached
+};
+
+struct allocation_event {
+    allocation_event_type type;
+    /// nullptr for the error_injected and peak_reached events.
+    void const *ptr;
+    /// The allocation size, the size of the failed allocation or the new peak of the allocated size.
+    std::uint64_t size;
+    /// Call site (with stack capture).
+    void const *site;
+    /// Steady clock time.
+    std::uint64_t time_nanoseconds;
+    /// Index of the publishing thread (the threads are numbered in the order of their first event).
+    std::uint64_t thread;
+};
+
+/// An observer must not call unregister_observer() or flush_allocation_events().
+using allocation_observer = void (*)(allocation_event const &event, void *context);
+std::size_t const max_allocation_observers = 8;
+
+/// Registers an observer and starts the consumer thread if needed.
+/// Returns the id of the observer (0 if it is null or if there are already max_allocation_observers).
+std::size_t register_observer(allocation_observer observer, void *context = nullptr);
+/// Once it returns, the observer isn't called anymore. The consumer thread is stopped with the last observer.
+void unregister_observer(std::size_t id);
+/// Waits until the events published before the call are delivered.
+void flush_allocation_events();
+
+struct allocation_event_counters {
+    std::uint64_t published_events;
+    std::uint64_t delivered_events;
+    std::uint64_t dropped_events;
+};
+
+allocation_event_counters allocation_event_statistics() noexcept;
+// \}
+
 /// Runs a function under resume/pause error testing.
 template <typename F> decltype(auto) run_error_testing(F const &f) {
     resume_error_testing();
@@ -61,6 +696,81 @@ template <typename F> decltype(auto) run_no_error_testing(F const &f) {
     return f();
 }
 
+namespace detail {
+
+// Allocation statistics of a tag.
+class tag_statistics {
+  public:
+    void on_allocate(std::size_t size) noexcept {
+        m_total_allocations.fetch_add(1, std::memory_order_relaxed);
+        m_live_allocations.fetch_add(1, std::memory_order_relaxed);
+        auto allocated_size = m_allocated_size.fetch_add(size, std::memory_order_relaxed) + size;
+        auto max_allocated_size = m_max_allocated_size.load(std::memory_order_relaxed);
+        while (max_allocated_size < allocated_size &&
+               !m_max_allocated_size.compare_exchange_weak(max_allocated_size, allocated_size,
+                                                           std::memory_order_relaxed)) {
+        }
+    }
+
+    void on_deallocate(std::size_t size) noexcept {
+        m_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        m_allocated_size.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    allocation_statistics get() const noexcept {
+        return allocation_statistics{
+            m_total_allocations.load(std::memory_order_relaxed), m_live_allocations.load(std::memory_order_relaxed),
+            m_max_allocated_size.load(std::memory_order_relaxed), m_allocated_size.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    std::atomic<std::uint64_t> m_total_allocations{};
+    std::atomic<std::uint64_t> m_live_allocations{};
+    std::atomic<std::uint64_t> m_allocated_size{};
+    std::atomic<std::uint64_t> m_max_allocated_size{};
+};
+
+template <typename Tag> tag_statistics &statistics_of_tag() noexcept {
+    static tag_statistics statistics;
+    return statistics;
+}
+
+} // namespace detail
+
+/// STL allocator allocating with dev_new::allocate() and keeping separate statistics for each tag.
+/// The tag is any type identifying a container or a subsystem; the allocations made by all the allocators with the
+/// same tag are aggregated and reported by `stats<Tag>()`.
+template <typename T, typename Tag = void> class allocator {
+  public:
+    static_assert(alignof(T) <= alignof(std::max_align_t), "dev_new::allocator: over-aligned types not supported");
+
+    using value_type = T;
+    template <typename U> struct rebind { using other = allocator<U, Tag>; };
+
+    allocator() noexcept = default;
+    // NOLINTNEXTLINE(google-explicit-constructor, hicpp-explicit-conversions)
+    template <typename U> allocator(allocator<U, Tag> const & /*unused*/) noexcept {}
+    template <typename U> bool operator==(allocator<U, Tag> const & /*unused*/) const noexcept { return true; }
+    template <typename U> bool operator!=(allocator<U, Tag> const & /*unused*/) const noexcept { return false; }
+
+    T *allocate(std::size_t count) const {
+        if (count > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        auto ptr = static_cast<T *>(dev_new::allocate(count * sizeof(T)));
+        detail::statistics_of_tag<Tag>().on_allocate(count * sizeof(T));
+        return ptr;
+    }
+
+    void deallocate(T *const ptr, std::size_t count) const noexcept {
+        dev_new::deallocate(ptr);
+        detail::statistics_of_tag<Tag>().on_deallocate(count * sizeof(T));
+    }
+};
+
+/// Returns the allocation statistics of the allocators with the given tag.
+template <typename Tag> allocation_statistics stats() noexcept { return detail::statistics_of_tag<Tag>().get(); }
+
 } // namespace dev_new
 
 /// Assertion macros.
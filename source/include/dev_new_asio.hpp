@@ -0,0 +1,242 @@
+#ifndef DEV_NEW_ASIO_HPP
+#define DEV_NEW_ASIO_HPP
+
+#include "dev_new.hpp"
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dev_new {
+
+/// Allocator for asio handlers using the recycled handler allocations (see allocate_handler()).
+/// It can be associated with a handler using bind_handler_allocator() or, with asio versions providing it,
+/// `asio::bind_allocator(dev_new::handler_allocator<void>(), handler)`.
+template <typename T> class handler_allocator {
+  public:
+    using value_type = T;
+
+    handler_allocator() noexcept = default;
+    // NOLINTNEXTLINE(google-explicit-constructor, hicpp-explicit-conversions)
+    template <typename U> handler_allocator(handler_allocator<U> const & /*unused*/) noexcept {}
+    template <typename U> bool operator==(handler_allocator<U> const & /*unused*/) const noexcept { return true; }
+    template <typename U> bool operator!=(handler_allocator<U> const & /*unused*/) const noexcept { return false; }
+
+    T *allocate(std::size_t count) const {
+        if (count > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(allocate_handler(count * sizeof(T)));
+    }
+    void deallocate(T *const ptr, std::size_t count) const noexcept { deallocate_handler(ptr, count * sizeof(T)); }
+};
+
+/// Handler associated with a handler_allocator.
+/// The associated executor of the wrapped handler is preserved.
+template <typename Handler> class allocating_handler {
+  public:
+    using allocator_type = handler_allocator<void>;
+
+    template <typename H> explicit allocating_handler(H &&handler) : m_handler(std::forward<H>(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(); }
+
+    Handler &get() noexcept { return m_handler; }
+    Handler const &get() const noexcept { return m_handler; }
+
+    template <typename... Args> decltype(auto) operator()(Args &&... args) {
+        return m_handler(std::forward<Args>(args)...);
+    }
+
+  private:
+    Handler m_handler;
+};
+
+/// Associates a handler_allocator with a handler.
+template <typename Handler> allocating_handler<std::decay_t<Handler>> bind_handler_allocator(Handler &&handler) {
+    return allocating_handler<std::decay_t<Handler>>(std::forward<Handler>(handler));
+}
+
+/// Executor running the functions submitted to it in the operation scope of an operation attribution.
+/// Composed operations submit their intermediate handlers to the associated executor of their completion handler, so
+/// the allocations made by all the steps of an operation whose completion handler is bound with bind_attribution()
+/// are charged to that operation.
+template <typename Executor> class attributing_executor {
+  public:
+    attributing_executor(Executor executor, std::shared_ptr<operation_attribution> attribution) noexcept
+        : m_executor(std::move(executor)), m_attribution(std::move(attribution)) {}
+
+    Executor const &get_inner_executor() const noexcept { return m_executor; }
+    std::shared_ptr<operation_attribution> const &attribution() const noexcept { return m_attribution; }
+
+    decltype(auto) context() const noexcept { return m_executor.context(); }
+    void on_work_started() const noexcept { m_executor.on_work_started(); }
+    void on_work_finished() const noexcept { m_executor.on_work_finished(); }
+
+    template <typename F, typename A> void dispatch(F &&f, A const &allocator) const {
+        m_executor.dispatch(wrap(std::forward<F>(f)), allocator);
+    }
+    template <typename F, typename A> void post(F &&f, A const &allocator) const {
+        m_executor.post(wrap(std::forward<F>(f)), allocator);
+    }
+    template <typename F, typename A> void defer(F &&f, A const &allocator) const {
+        m_executor.defer(wrap(std::forward<F>(f)), allocator);
+    }
+
+    bool operator==(attributing_executor const &other) const noexcept {
+        return m_executor == other.m_executor && m_attribution == other.m_attribution;
+    }
+    bool operator!=(attributing_executor const &other) const noexcept { return !(*this == other); }
+
+  private:
+    template <typename F> class scoped_function {
+      public:
+        scoped_function(F &&f, std::shared_ptr<operation_attribution> attribution)
+            : m_f(std::move(f)), m_attribution(std::move(attribution)) {}
+
+        void operator()() {
+            operation_scope scope(*m_attribution);
+            m_f();
+        }
+
+      private:
+        F m_f;
+        std::shared_ptr<operation_attribution> m_attribution;
+    };
+
+    template <typename F> scoped_function<std::decay_t<F>> wrap(F &&f) const {
+        return scoped_function<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(f)), m_attribution);
+    }
+
+    Executor m_executor;
+    std::shared_ptr<operation_attribution> m_attribution;
+};
+
+/// Handler running in the operation scope of an operation attribution.
+/// Its associated executor is the attributing_executor wrapping the associated executor of the wrapped handler and
+/// its associated allocator is the one of the wrapped handler. The operation completes (and the operation observer is
+/// called) when the handler and all the copies of its associated executor have been destroyed.
+template <typename Handler> class attributed_handler {
+  public:
+    template <typename H>
+    attributed_handler(H &&handler, std::shared_ptr<operation_attribution> attribution)
+        : m_handler(std::forward<H>(handler)), m_attribution(std::move(attribution)) {}
+
+    Handler &get() noexcept { return m_handler; }
+    Handler const &get() const noexcept { return m_handler; }
+    std::shared_ptr<operation_attribution> const &attribution() const noexcept { return m_attribution; }
+
+    template <typename... Args> decltype(auto) operator()(Args &&... args) {
+        operation_scope scope(*m_attribution);
+        return m_handler(std::forward<Args>(args)...);
+    }
+
+  private:
+    Handler m_handler;
+    std::shared_ptr<operation_attribution> m_attribution;
+};
+
+/// Binds a handler to a new operation attribution.
+/// The name must have static storage duration (e.g. a string literal).
+template <typename Handler>
+attributed_handler<std::decay_t<Handler>> bind_attribution(char const *name, Handler &&handler) {
+    return attributed_handler<std::decay_t<Handler>>(std::forward<Handler>(handler),
+                                                     std::make_shared<operation_attribution>(name));
+}
+
+/// Handler recording its latency, from its binding (typically when its asynchronous operation starts) to its
+/// invocation, in nanoseconds (e.g. to compare the latency percentiles with and without latency injection).
+/// Its associated executor and allocator are the ones of the wrapped handler.
+template <typename Handler> class timed_handler {
+  public:
+    template <typename H>
+    timed_handler(H &&handler, latency_recorder &recorder)
+        : m_handler(std::forward<H>(handler)), m_recorder(&recorder), m_start(std::chrono::steady_clock::now()) {}
+
+    Handler &get() noexcept { return m_handler; }
+    Handler const &get() const noexcept { return m_handler; }
+
+    template <typename... Args> decltype(auto) operator()(Args &&... args) {
+        auto latency = std::chrono::steady_clock::now() - m_start;
+        m_recorder->record(
+            static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+        return m_handler(std::forward<Args>(args)...);
+    }
+
+  private:
+    Handler m_handler;
+    latency_recorder *m_recorder;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/// Binds a handler to a latency recorder (which must outlive the handler).
+template <typename Handler>
+timed_handler<std::decay_t<Handler>> bind_latency(latency_recorder &recorder, Handler &&handler) {
+    return timed_handler<std::decay_t<Handler>>(std::forward<Handler>(handler), recorder);
+}
+
+} // namespace dev_new
+
+namespace boost {
+namespace asio {
+
+template <typename Handler, typename Executor>
+struct associated_executor<dev_new::allocating_handler<Handler>, Executor> {
+    using type = associated_executor_t<Handler, Executor>;
+
+    static type get(dev_new::allocating_handler<Handler> const &handler,
+                    Executor const &executor = Executor()) noexcept {
+        return get_associated_executor(handler.get(), executor);
+    }
+};
+
+template <typename Handler, typename Executor>
+struct associated_executor<dev_new::attributed_handler<Handler>, Executor> {
+    using type = dev_new::attributing_executor<associated_executor_t<Handler, Executor>>;
+
+    static type get(dev_new::attributed_handler<Handler> const &handler,
+                    Executor const &executor = Executor()) noexcept {
+        return type(get_associated_executor(handler.get(), executor), handler.attribution());
+    }
+};
+
+template <typename Handler, typename Allocator>
+struct associated_allocator<dev_new::attributed_handler<Handler>, Allocator> {
+    using type = associated_allocator_t<Handler, Allocator>;
+
+    static type get(dev_new::attributed_handler<Handler> const &handler,
+                    Allocator const &allocator = Allocator()) noexcept {
+        return get_associated_allocator(handler.get(), allocator);
+    }
+};
+
+template <typename Handler, typename Executor>
+struct associated_executor<dev_new::timed_handler<Handler>, Executor> {
+    using type = associated_executor_t<Handler, Executor>;
+
+    static type get(dev_new::timed_handler<Handler> const &handler, Executor const &executor = Executor()) noexcept {
+        return get_associated_executor(handler.get(), executor);
+    }
+};
+
+template <typename Handler, typename Allocator>
+struct associated_allocator<dev_new::timed_handler<Handler>, Allocator> {
+    using type = associated_allocator_t<Handler, Allocator>;
+
+    static type get(dev_new::timed_handler<Handler> const &handler,
+                    Allocator const &allocator = Allocator()) noexcept {
+        return get_associated_allocator(handler.get(), allocator);
+    }
+};
+
+} // namespace asio
+} // namespace boost
+
+#endif
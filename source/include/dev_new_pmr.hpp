@@ -0,0 +1,99 @@
+#ifndef DEV_NEW_PMR_HPP
+#define DEV_NEW_PMR_HPP
+
+#include "dev_new.hpp"
+
+#if __has_include(<memory_resource>)
+#define DEV_NEW_HAS_PMR 1
+#else
+#define DEV_NEW_HAS_PMR 0
+#endif
+
+#if DEV_NEW_HAS_PMR
+
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+
+namespace dev_new {
+
+/// Memory resource allocating with dev_new::allocate().
+/// The global allocation statistics and error testing apply to its allocations.
+std::pmr::memory_resource *global_resource() noexcept;
+
+/// Memory resource tracking its own allocations.
+/// Each instance keeps its own allocation statistics and error countdown, the countdown having the same semantics as
+/// the global one (see set_error_countdown()). The allocations are forwarded to an upstream resource.
+class tracked_resource : public std::pmr::memory_resource {
+  public:
+    explicit tracked_resource(std::pmr::memory_resource *upstream = global_resource()) noexcept;
+    ~tracked_resource() override = default;
+
+    tracked_resource(tracked_resource const & /*unused*/) = delete;
+    tracked_resource(tracked_resource && /*unused*/) = delete;
+    tracked_resource &operator=(tracked_resource const & /*unused*/) = delete;
+    tracked_resource &operator=(tracked_resource && /*unused*/) = delete;
+
+    std::pmr::memory_resource *upstream_resource() const noexcept { return m_upstream; }
+    allocation_statistics statistics() const noexcept;
+
+    /// Error testing of this resource (see the global functions with the same names).
+    // \{
+    void set_error_countdown(std::uint64_t countdown) noexcept;
+    std::uint64_t get_error_countdown() const noexcept;
+    void pause_error_testing() noexcept;
+    void resume_error_testing() noexcept;
+    // \}
+
+  protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override;
+
+  private:
+    using lock_guard = std::lock_guard<std::mutex>;
+
+    std::pmr::memory_resource *m_upstream;
+    mutable std::mutex m_mutex;
+    allocation_statistics m_statistics;
+
+    bool m_error_testing;
+    std::uint64_t m_error_countdown;
+    std::uint64_t m_error_allocated_size;
+};
+
+/// Stack of memory resources for comparing an allocation strategy (e.g. an arena or a pool resource) under the same
+/// statistics and error testing.
+/// The allocations made by the users of the stack are tracked by the `front()` resource, which forwards them to the
+/// strategy resource. The memory the strategy resource gets from its upstream is tracked by the `upstream()` resource.
+template <typename Strategy> class tracked_stack {
+  public:
+    /// Constructs the strategy resource with the given arguments followed by its upstream resource.
+    template <typename... Args>
+    explicit tracked_stack(Args &&... args)
+        : m_upstream{}, m_strategy{std::forward<Args>(args)..., &m_upstream}, m_front{&m_strategy} {}
+
+    std::pmr::memory_resource *resource() noexcept { return &m_front; }
+
+    tracked_resource &front() noexcept { return m_front; }
+    Strategy &strategy() noexcept { return m_strategy; }
+    tracked_resource &upstream() noexcept { return m_upstream; }
+
+  private:
+    tracked_resource m_upstream;
+    Strategy m_strategy;
+    tracked_resource m_front;
+};
+
+/// Arena (monotonic buffer) and pool strategies.
+// \{
+using tracked_monotonic_stack = tracked_stack<std::pmr::monotonic_buffer_resource>;
+using tracked_pool_stack = tracked_stack<std::pmr::unsynchronized_pool_resource>;
+// \}
+
+} // namespace dev_new
+
+#endif
+
+#endif
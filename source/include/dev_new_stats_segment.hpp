@@ -0,0 +1,116 @@
+#ifndef DEV_NEW_STATS_SEGMENT_HPP
+#define DEV_NEW_STATS_SEGMENT_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace dev_new {
+
+/// Shared memory statistics segment (see publish_statistics()).
+/// The segment is written by the publishing process only and can be read by any number of processes (e.g. the
+/// dev_new_top tool). Its snapshot is protected by a sequence lock: the readers never block the writer, they retry
+/// when the snapshot changed while they were copying it.
+namespace stats_segment {
+
+std::uint32_t const magic = 0x4E564544U;
+std::uint32_t const version = 1;
+std::size_t const max_categories = 32;
+std::size_t const max_sites = 32;
+std::size_t const name_size = 32;
+
+struct category {
+    /// Truncated and null-terminated.
+    std::array<char, name_size> name;
+    std::uint64_t total_allocations;
+    std::uint64_t total_deallocations;
+    std::uint64_t allocated_size;
+    std::uint64_t max_allocated_size;
+    std::uint64_t total_allocated_size;
+};
+
+struct site {
+    std::uint64_t address;
+    std::uint64_t deallocations;
+    /// Upper bounds of the median lifetimes (in nanoseconds and allocation clock ticks).
+    std::uint64_t median_nanoseconds;
+    std::uint64_t median_ticks;
+};
+
+struct snapshot {
+    std::uint64_t pid;
+    std::uint64_t publications;
+    /// Steady clock time of the publication.
+    std::uint64_t time_nanoseconds;
+
+    std::uint64_t total_allocations;
+    std::uint64_t live_allocations;
+    std::uint64_t allocated_size;
+    std::uint64_t max_allocated_size;
+    std::uint64_t lock_acquisitions;
+    std::uint64_t contended_lock_acquisitions;
+    std::uint64_t lock_wait_nanoseconds;
+    std::uint64_t remote_frees;
+    std::uint64_t large_live_allocations;
+    std::uint64_t large_mapped_size;
+
+    /// The categories with the highest churn first.
+    std::uint64_t category_count;
+    std::array<category, max_categories> categories;
+    /// The call sites with the most deallocations first (with the lifetimes feature).
+    std::uint64_t site_count;
+    std::array<site, max_sites> sites;
+};
+
+struct segment {
+    std::uint32_t magic;
+    std::uint32_t version;
+    /// Odd while the snapshot is written.
+    std::atomic<std::uint64_t> sequence;
+    snapshot data;
+};
+
+/// Returns the shared memory object name of the segment of a process (the segment is /dev/shm/dev_new.<pid>).
+inline std::array<char, 32> name(std::uint64_t pid) noexcept {
+    std::array<char, 32> name{};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::snprintf(name.data(), name.size(), "/dev_new.%llu", static_cast<unsigned long long>(pid));
+    return name;
+}
+
+/// Publishes a snapshot (there is a single writer).
+inline void write(segment &segment, snapshot const &data) noexcept {
+    auto sequence = segment.sequence.load(std::memory_order_relaxed);
+    segment.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&segment.data, &data, sizeof(data));
+    segment.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/// Reads a consistent snapshot.
+/// Returns false if the segment is invalid or if the snapshot kept changing.
+inline bool read(segment const &segment, snapshot &data, unsigned max_attempts = 1000) noexcept {
+    if (segment.magic != magic || segment.version != version) {
+        return false;
+    }
+    for (unsigned attempt = 0; attempt != max_attempts; ++attempt) {
+        auto sequence = segment.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1U) != 0) {
+            continue;
+        }
+        std::memcpy(&data, &segment.data, sizeof(data));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment.sequence.load(std::memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace stats_segment
+} // namespace dev_new
+
+#endif
@@ -1,13 +1,86 @@
 #include "dev_new.hpp"
+#include "dev_new_stats_segment.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <mutex>
 #include <new>
-#include <unordered_set>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 
 #include <boost/intrusive/parent_from_member.hpp>
-#include <boost/scope_exit.hpp>
+#include <boost/predef/architecture.h>
+#include <boost/predef/compiler.h>
+#include <boost/predef/os.h>
+
+#if BOOST_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if BOOST_OS_LINUX
+#include <csetjmp>
+#include <fcntl.h>
+#include <link.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#endif
+
+#if BOOST_COMP_MSVC
+#include <intrin.h>
+#elif BOOST_ARCH_X86
+#include <x86intrin.h>
+#endif
+
+// Compile-time features of the memory manager (a disabled feature costs nothing at runtime).
+// - tracking: the live allocations are kept in pointer tables (otherwise pointers are only validated by the
+//   allocation headers)
+// - error injection: allocations and error points simulate out-of-memory errors (error testing)
+// - statistics: per-thread and per-category statistics
+// - stack capture: the call site (return address) of each allocation is recorded
+// - fill patterns: new and freed memory is filled with patterns
+// - lifetimes: the lifetimes of the allocations are added to histograms
+// \{
+#ifndef DEV_NEW_TRACKING
+#define DEV_NEW_TRACKING 1
+#endif
+#ifndef DEV_NEW_ERROR_INJECTION
+#define DEV_NEW_ERROR_INJECTION 1
+#endif
+#ifndef DEV_NEW_STATISTICS
+#define DEV_NEW_STATISTICS 1
+#endif
+#ifndef DEV_NEW_STACK_CAPTURE
+#define DEV_NEW_STACK_CAPTURE 0
+#endif
+#ifndef DEV_NEW_FILL_PATTERNS
+#define DEV_NEW_FILL_PATTERNS 0
+#endif
+#ifndef DEV_NEW_LIFETIMES
+#define DEV_NEW_LIFETIMES 0
+#endif
+// \}
+
+// Return address of the current function (the call site of an allocation).
+#if BOOST_COMP_GNUC || BOOST_COMP_CLANG
+#define DEV_NEW_RETURN_ADDRESS() __builtin_return_address(0)
+#elif BOOST_COMP_MSVC
+#define DEV_NEW_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define DEV_NEW_RETURN_ADDRESS() nullptr
+#endif
 
 namespace dev_new {
 
@@ -35,27 +108,11 @@ void *malloc_allocate(std::size_t count, std::nothrow_t const & /*unused*/) noex
     return std::malloc(count);
 }
 
-void *malloc_allocate(std::size_t count) {
-    if (count == 0) {
-        return nullptr;
-    }
-
-    auto *ptr = malloc_allocate(count, std::nothrow);
-    if (ptr == nullptr) {
-        throw std::bad_alloc();
-    }
-
-    return ptr;
-}
-
-template <typename T> T *malloc_allocate(std::size_t count) {
-    if (count == 0) {
-        return nullptr;
-    }
+template <typename T> T *malloc_allocate(std::size_t count, std::nothrow_t const & /*unused*/) noexcept {
     if (count > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
-        throw std::bad_array_new_length();
+        return nullptr;
     }
-    return static_cast<T *>(malloc_allocate(count * sizeof(T)));
+    return static_cast<T *>(malloc_allocate(count * sizeof(T), std::nothrow));
 }
 
 void malloc_deallocate(void *ptr) noexcept {
@@ -63,379 +120,4048 @@ void malloc_deallocate(void *ptr) noexcept {
     std::free(ptr);
 }
 
-// Malloc based allocator.
-// Based on:
-// https://stackoverflow.com/a/36521845
-template <typename T> struct mallocator {
-    using value_type = T;
-    mallocator() noexcept = default;
-    // NOLINTNEXTLINE(google-explicit-constructor, hicpp-explicit-conversions)
-    template <typename U> mallocator(mallocator<U> const & /*unused*/) noexcept {}
-    template <typename U> bool operator==(mallocator<U> const & /*unused*/) const noexcept { return true; }
-    template <typename U> bool operator!=(mallocator<U> const & /*unused*/) const noexcept { return false; }
+// Memory mapping of large allocations.
+// \{
+#if BOOST_OS_UNIX
+bool const large_allocations_supported = true;
 
-    T *allocate(std::size_t count) const { return malloc_allocate<T>(count); }
-    void deallocate(T *const ptr, std::size_t /*unused*/) const noexcept { malloc_deallocate(ptr); }
-};
+std::size_t page_size() noexcept { return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)); }
 
-// Object created for each allocation.
-struct allocation_object {
-    static auto const magic_value = 0x0123ABCD6789CDEFULL;
-    explicit allocation_object(std::size_t count) : magic{magic_value}, count{count}, ptr{} {}
-    ~allocation_object() {
-        DEV_NEW_ASSERT(magic == magic_value);
-        magic = 0xABCD0123CDEF6789ULL;
-    }
+void *map_pages(std::size_t size) noexcept {
+    void *ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast, performance-no-int-to-ptr)
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
 
-    allocation_object(allocation_object const & /*unused*/) = delete;
-    allocation_object(allocation_object && /*unused*/) = delete;
-    allocation_object &operator=(allocation_object const & /*unused*/) = delete;
-    allocation_object &operator=(allocation_object && /*unused*/) = delete;
+void unmap_pages(void *ptr, std::size_t size) noexcept { ::munmap(ptr, size); }
 
-    std::uint64_t magic;
-    std::size_t count;
-    // User data starts here (aligned as size_t).
-    std::size_t ptr;
-};
+// Returns the pages to the system while keeping the mapping.
+void discard_pages(void *ptr, std::size_t size) noexcept { ::madvise(ptr, size, MADV_DONTNEED); }
+#else
+bool const large_allocations_supported = false;
 
-// Allocation memory manager.
-class memory_manager {
+std::size_t page_size() noexcept { return 4096; }
+void *map_pages(std::size_t /*unused*/) noexcept { return nullptr; }
+void unmap_pages(void * /*unused*/, std::size_t /*unused*/) noexcept {}
+void discard_pages(void * /*unused*/, std::size_t /*unused*/) noexcept {}
+#endif
+// \}
+
+// Hash set of the allocated pointers (open addressing with linear probing).
+// An empty table doesn't own any memory, so that it can be constant-initialized. The table isn't destroyed (its memory
+// is not freed) as it is used by the memory manager, which is never destroyed.
+class pointer_table {
   public:
-    static memory_manager &instance() {
-        static memory_manager m;
-        return m;
+    constexpr pointer_table() noexcept = default;
+
+    std::size_t size() const noexcept { return m_size; }
+    std::size_t capacity() const noexcept { return m_capacity; }
+
+    bool contains(void const *ptr) const noexcept { return find(ptr) != m_capacity; }
+
+    // Returns false if the table could not grow.
+    bool insert(void *ptr) noexcept {
+        if ((m_size + 1) * 2 > m_capacity && !rehash(std::max(min_capacity, m_capacity * 2))) {
+            return false;
+        }
+        auto index = home(ptr);
+        std::size_t probes = 1;
+        while (slot(index) != nullptr) {
+            DEV_NEW_ASSERT(slot(index) != ptr);
+            index = next(index);
+            ++probes;
+        }
+        record_probes(probes);
+        slot(index) = ptr;
+        ++m_size;
+        return true;
     }
 
-    static memory_manager *instance(std::nothrow_t const & /*unused*/) noexcept {
-        memory_manager *m = nullptr;
-        try {
-            m = &instance();
-        } catch (std::exception &) {
+    // Erases a pointer using backward shift deletion (no tombstones).
+    bool erase(void const *ptr) noexcept {
+        auto index = find(ptr);
+        if (index == m_capacity) {
+            return false;
+        }
+        for (auto moved = next(index); slot(moved) != nullptr; moved = next(moved)) {
+            // The entry can fill the hole if the hole is between its home slot and its slot.
+            auto moved_home = home(slot(moved));
+            if (((moved - moved_home) & (m_capacity - 1)) >= ((moved - index) & (m_capacity - 1))) {
+                slot(index) = slot(moved);
+                index = moved;
+            }
+        }
+        slot(index) = nullptr;
+        --m_size;
+        return true;
+    }
+
+    // Calls a function with each pointer.
+    template <typename F> void for_each(F const &f) const noexcept {
+        for (std::size_t index = 0; index != m_capacity; ++index) {
+            if (auto ptr = slot(index)) {
+                f(ptr);
+            }
         }
-        return m;
     }
 
-    memory_manager(memory_manager const & /*unused*/) = delete;
-    memory_manager(memory_manager && /*unused*/) = delete;
-    memory_manager &operator=(memory_manager const & /*unused*/) = delete;
-    memory_manager &operator=(memory_manager && /*unused*/) = delete;
+    // Probe lengths of the lookups (only counted when enabled).
+    // \{
+    void count_probes(bool enabled) noexcept { m_count_probes = enabled; }
+    std::array<std::uint64_t, probe_length_buckets> const &probe_lengths() const noexcept { return m_probe_lengths; }
+    // \}
 
-    std::uint64_t total_allocations() const noexcept {
-        if (!is_valid()) {
-            return 0;
+    // Returns false if the table could not grow.
+    bool reserve(std::size_t count) noexcept {
+        auto capacity = std::max(min_capacity, m_capacity);
+        while (count * 2 > capacity) {
+            capacity *= 2;
         }
+        return capacity == m_capacity || rehash(capacity);
+    }
 
-        lock_guard lock(m_mutex);
-        return m_total_allocations;
+  private:
+    static constexpr std::size_t min_capacity = 1024;
+
+    void *&slot(std::size_t index) const noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        return m_slots[index];
     }
-    std::uint64_t live_allocations() const noexcept {
-        if (!is_valid()) {
-            return 0;
-        }
+    std::size_t next(std::size_t index) const noexcept { return (index + 1) & (m_capacity - 1); }
 
-        lock_guard lock(m_mutex);
-        return m_pointers.size();
+    // Fibonacci hashing of the pointer value.
+    std::size_t home(void const *ptr) const noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto value = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(ptr));
+        return static_cast<std::size_t>((value * 0x9E3779B97F4A7C15ULL) >> m_shift);
     }
 
-    std::uint64_t max_allocated_size() const noexcept {
-        if (!is_valid()) {
-            return 0;
+    // Returns the slot of the pointer or the capacity if not found.
+    std::size_t find(void const *ptr) const noexcept {
+        if (m_size == 0) {
+            return m_capacity;
         }
-
-        lock_guard lock(m_mutex);
-        return m_max_allocated_size;
+        std::size_t probes = 1;
+        for (auto index = home(ptr); slot(index) != nullptr; index = next(index), ++probes) {
+            if (slot(index) == ptr) {
+                record_probes(probes);
+                return index;
+            }
+        }
+        record_probes(probes);
+        return m_capacity;
     }
-    std::uint64_t allocated_size() const noexcept {
-        if (!is_valid()) {
-            return 0;
+
+    void record_probes(std::size_t probes) const noexcept {
+        if (m_count_probes) {
+            ++m_probe_lengths.at(std::min(probes, probe_length_buckets) - 1);
         }
+    }
 
-        lock_guard lock(m_mutex);
-        return m_allocated_size;
+    bool rehash(std::size_t capacity) noexcept {
+        auto slots = malloc_allocate<void *>(capacity, std::nothrow);
+        if (slots == nullptr) {
+            return false;
+        }
+        std::fill_n(slots, capacity, nullptr);
+        auto old_slots = m_slots;
+        auto old_capacity = m_capacity;
+        m_slots = slots;
+        m_capacity = capacity;
+        m_shift = 64;
+        for (auto c = capacity; c > 1; c /= 2) {
+            --m_shift;
+        }
+        for (std::size_t index = 0; index != old_capacity; ++index) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (auto ptr = old_slots[index]) {
+                auto new_index = home(ptr);
+                while (slot(new_index) != nullptr) {
+                    new_index = next(new_index);
+                }
+                slot(new_index) = ptr;
+            }
+        }
+        malloc_deallocate(old_slots);
+        return true;
     }
 
-    void set_error_countdown(std::uint64_t countdown) noexcept {
-        if (!is_valid()) {
-            return;
+    void **m_slots{};
+    std::size_t m_capacity{};
+    std::size_t m_size{};
+    unsigned m_shift{64};
+    bool m_count_probes{};
+    mutable std::array<std::uint64_t, probe_length_buckets> m_probe_lengths{};
+};
+
+// Optional words of the allocation header: the index of each field used by a feature policy and the number of words
+// (even, so that the user data stays aligned as max_align_t).
+template <typename Features> struct allocation_optional_words {
+    static std::size_t const operation = 0;
+    static std::size_t const site = operation + (Features::statistics ? 1 : 0);
+    static std::size_t const birth_time = site + (Features::stack_capture ? 1 : 0);
+    static std::size_t const birth_tick = birth_time + (Features::lifetimes ? 1 : 0);
+    static std::size_t const count = (birth_tick + (Features::lifetimes ? 1 : 0) + 1) / 2 * 2;
+};
+
+// Data members of the allocation header.
+template <std::size_t OptionalWords> struct allocation_data {
+    allocation_data(std::uint32_t magic, std::uint16_t category, std::uint16_t flags, std::size_t count) noexcept
+        : magic{magic}, category{category}, flags{flags}, count{count}, optional{}, ptr{} {}
+
+    std::atomic<std::uint32_t> magic;
+    std::uint16_t category;
+    std::uint16_t flags;
+    std::size_t count;
+    std::array<std::uint64_t, OptionalWords> optional;
+    // User data starts here.
+    // While the deallocation is deferred, it holds the next allocation in the remote-free list.
+    std::size_t ptr;
+};
+
+template <> struct allocation_data<0> {
+    allocation_data(std::uint32_t magic, std::uint16_t category, std::uint16_t flags, std::size_t count) noexcept
+        : magic{magic}, category{category}, flags{flags}, count{count}, ptr{} {}
+
+    std::atomic<std::uint32_t> magic;
+    std::uint16_t category;
+    std::uint16_t flags;
+    std::size_t count;
+    std::size_t ptr;
+};
+
+// Object created for each allocation.
+// The call site, the operation and the lifetime fields are only stored by the feature policies that use them.
+template <typename Features>
+struct basic_allocation_object : allocation_data<allocation_optional_words<Features>::count> {
+    using words = allocation_optional_words<Features>;
+
+    static auto const magic_value = 0x6789CDEFU;
+    // Magic value of an allocation whose deallocation has been deferred.
+    static auto const remote_free_magic_value = 0x6789FEEDU;
+    // The allocation is a memory mapping of its own.
+    static std::uint16_t const large_flag = 1U;
+    // The allocation was made in the bootstrap arena.
+    static std::uint16_t const bootstrap_flag = 2U;
+    // The allocation was made in the region of an arena scope.
+    static std::uint16_t const arena_flag = 4U;
+    // Fill patterns of the allocated and freed user data.
+    static unsigned char const allocated_fill = 0xCDU;
+    static unsigned char const freed_fill = 0xDDU;
+    basic_allocation_object(std::size_t count, std::uint16_t category, std::uint16_t flags, void const *site,
+                            std::uint32_t operation) noexcept
+        : allocation_data<words::count>{magic_value, category, flags, count} {
+        if constexpr (Features::statistics) {
+            this->optional.at(words::operation) = operation;
         }
+        if constexpr (Features::stack_capture) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            this->optional.at(words::site) = reinterpret_cast<std::uintptr_t>(site);
+        }
+    }
+    ~basic_allocation_object() {
+        DEV_NEW_ASSERT(this->magic.load(std::memory_order_relaxed) == magic_value);
+        this->magic.store(0xCDEF6789U, std::memory_order_relaxed);
+    }
 
-        lock_guard lock(m_mutex);
-        m_error_testing = true;
-        m_error_countdown = countdown;
-        // If countdown is zero, all the subsequent allocations will fail.
-        m_error_allocated_size = m_allocated_size;
+    basic_allocation_object(basic_allocation_object const & /*unused*/) = delete;
+    basic_allocation_object(basic_allocation_object && /*unused*/) = delete;
+    basic_allocation_object &operator=(basic_allocation_object const & /*unused*/) = delete;
+    basic_allocation_object &operator=(basic_allocation_object && /*unused*/) = delete;
+
+    // Returns the allocation object of a user pointer.
+    static basic_allocation_object *from(void *ptr) noexcept {
+        return static_cast<basic_allocation_object *>(boost::intrusive::get_parent_from_member(
+            static_cast<std::size_t *>(ptr), &allocation_data<words::count>::ptr));
     }
 
-    std::uint64_t get_error_countdown() noexcept {
-        if (!is_valid()) {
-            return 0;
+    // Call site of the allocation (nullptr if not captured).
+    void const *site() const noexcept {
+        if constexpr (Features::stack_capture) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+            return reinterpret_cast<void const *>(static_cast<std::uintptr_t>(this->optional.at(words::site)));
+        } else {
+            return nullptr;
         }
+    }
 
-        lock_guard lock(m_mutex);
-        return m_error_countdown;
+    // Operation charged with the allocation (0 if none).
+    std::uint32_t operation() const noexcept {
+        if constexpr (Features::statistics) {
+            return static_cast<std::uint32_t>(this->optional.at(words::operation));
+        } else {
+            return 0;
+        }
     }
 
-    void pause_error_testing() noexcept {
-        if (!is_valid()) {
-            return;
+    // Allocation time (in nanoseconds) and allocation clock (total allocations) when the lifetime is tracked.
+    // \{
+    std::uint64_t &birth_time() noexcept { return this->optional.at(words::birth_time); }
+    std::uint64_t &birth_tick() noexcept { return this->optional.at(words::birth_tick); }
+    // \}
+};
+
+// Allocation counters of the current thread.
+thread_local allocation_counters thread_counters{};
+
+// Allocation category registry.
+// Category 0 is used for the allocations made outside any category scope and the last category for the allocations
+// of the categories registered once the registry is full.
+std::uint16_t const no_category = 0;
+std::uint16_t const overflow_category = max_categories - 1;
+std::array<std::atomic<char const *>, max_categories> category_names{};
+std::atomic<std::size_t> category_count{1};
+std::mutex category_registry_mutex;
+
+std::uint16_t find_category(char const *name, std::size_t count) noexcept {
+    for (std::size_t id = 1; id != count; ++id) {
+        auto id_name = category_names.at(id).load(std::memory_order_relaxed);
+        if (id_name == name || std::strcmp(id_name, name) == 0) {
+            return static_cast<std::uint16_t>(id);
         }
+    }
+    return no_category;
+}
 
-        lock_guard lock(m_mutex);
-        m_error_testing = false;
+std::uint16_t register_category(char const *name) noexcept {
+    if (auto id = find_category(name, category_count.load(std::memory_order_acquire))) {
+        return id;
     }
 
-    void resume_error_testing() noexcept {
-        if (!is_valid()) {
-            return;
+    std::lock_guard<std::mutex> lock(category_registry_mutex);
+    auto count = category_count.load(std::memory_order_relaxed);
+    if (auto id = find_category(name, count)) {
+        return id;
+    }
+    if (count == overflow_category) {
+        return overflow_category;
+    }
+    category_names.at(count).store(name, std::memory_order_relaxed);
+    category_count.store(count + 1, std::memory_order_release);
+    return static_cast<std::uint16_t>(count);
+}
+
+char const *category_name(std::size_t id) noexcept {
+    if (id == no_category) {
+        return "(none)";
+    }
+    if (id == overflow_category) {
+        return "(overflow)";
+    }
+    return category_names.at(id).load(std::memory_order_relaxed);
+}
+
+// Allocation counters of a category (in a per-thread table).
+struct category_counters {
+    std::atomic<std::uint64_t> total_allocations;
+    std::atomic<std::uint64_t> total_deallocations;
+    std::atomic<std::uint64_t> total_allocated_size;
+};
+
+// Per-thread table of category counters.
+// The tables are never freed: the table of a finished thread is reused by a new thread.
+struct category_table {
+    std::array<category_counters, max_categories> counters;
+    std::atomic<bool> in_use;
+    category_table *next;
+};
+
+// List of all the per-thread tables.
+std::atomic<category_table *> category_tables{};
+// Table used by the threads whose table couldn't be allocated or was already released.
+category_table shared_category_table{};
+
+category_table *acquire_category_table() noexcept {
+    for (auto table = category_tables.load(std::memory_order_acquire); table != nullptr; table = table->next) {
+        bool in_use = false;
+        if (table->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+            return table;
         }
+    }
 
-        lock_guard lock(m_mutex);
-        m_error_testing = true;
+    void *table_ptr = malloc_allocate(sizeof(category_table), std::nothrow);
+    if (table_ptr == nullptr) {
+        return nullptr;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    auto table = new (table_ptr) category_table{};
+    table->in_use.store(true, std::memory_order_relaxed);
+    table->next = category_tables.load(std::memory_order_relaxed);
+    while (!category_tables.compare_exchange_weak(table->next, table, std::memory_order_release)) {
     }
+    return table;
+}
 
-    void error_point() {
-        if (!is_valid()) {
-            return;
+// Category state of a thread: the stack of active category scopes and the thread's table of category counters.
+class thread_categories {
+  public:
+    static constexpr std::size_t max_depth = 64;
+
+    thread_categories() noexcept = default;
+    ~thread_categories() {
+        if (m_table != nullptr) {
+            m_table->in_use.store(false, std::memory_order_release);
+            m_table = nullptr;
         }
+        thread_finished = true;
+    }
+
+    thread_categories(thread_categories const & /*unused*/) = delete;
+    thread_categories(thread_categories && /*unused*/) = delete;
+    thread_categories &operator=(thread_categories const & /*unused*/) = delete;
+    thread_categories &operator=(thread_categories && /*unused*/) = delete;
 
-        lock_guard lock(m_mutex);
-        error_point_implementation(1);
+    // Scopes nested deeper than max_depth are attributed to the category at max_depth.
+    void push(std::uint16_t id) noexcept {
+        if (m_depth < max_depth) {
+            m_stack.at(m_depth) = id;
+        }
+        ++m_depth;
     }
 
-    void *allocate(std::size_t count, std::nothrow_t const & /*unused*/) noexcept {
-        void *ptr = nullptr;
-        try {
-            ptr = allocate(count);
-        } catch (std::exception &) {
+    void pop() noexcept {
+        DEV_NEW_ASSERT(m_depth != 0);
+        --m_depth;
+    }
+
+    std::uint16_t current() const noexcept {
+        return m_depth == 0 ? no_category : m_stack.at(std::min(m_depth, max_depth) - 1);
+    }
+
+    category_counters &counters(std::uint16_t id) noexcept {
+        if (thread_finished) {
+            return shared_category_table.counters.at(id);
         }
-        return ptr;
+        if (m_table == nullptr) {
+            m_table = acquire_category_table();
+        }
+        return (m_table != nullptr ? m_table : &shared_category_table)->counters.at(id);
     }
 
-    void *allocate(std::size_t count) {
-        if (!is_valid()) {
-            throw std::bad_alloc();
+  private:
+    std::array<std::uint16_t, max_depth> m_stack{};
+    std::size_t m_depth{};
+    category_table *m_table{};
+    // Set by the destructor, for the allocations made after it (see handler_cache::thread_finished).
+    static thread_local bool thread_finished;
+};
+
+thread_local bool thread_categories::thread_finished = false;
+thread_local thread_categories current_thread_categories;
+
+// Operation charged with the allocations of the current thread (0 if none).
+// An operation id holds the index of its slot in the low bits and the generation of the slot in the high bits.
+thread_local std::uint32_t current_operation = 0;
+std::uint32_t const operation_index_bits = 12;
+static_assert(max_operations == 1U << operation_index_bits, "operation ids don't match max_operations");
+
+std::atomic<operation_observer> current_operation_observer{};
+
+// Bump-pointer region of an arena scope (used under the manager lock).
+// The allocations are laid out one after the other in a chain of memory blocks, so that the ones still live when the
+// region is released can be found by walking the blocks.
+class arena {
+  public:
+    explicit arena(std::size_t block_size) noexcept : m_block_size{block_size} {}
+    ~arena() {
+        while (m_blocks != nullptr) {
+            auto next = m_blocks->next;
+            malloc_deallocate(m_blocks);
+            m_blocks = next;
         }
+    }
 
-        lock_guard lock(m_mutex);
-        error_point_implementation(count);
+    arena(arena const & /*unused*/) = delete;
+    arena(arena && /*unused*/) = delete;
+    arena &operator=(arena const & /*unused*/) = delete;
+    arena &operator=(arena && /*unused*/) = delete;
 
-        void *allocation_ptr = malloc_allocate(sizeof(allocation_object) + count);
-        bool commit = false;
-        BOOST_SCOPE_EXIT_ALL(&) {
-            if (!commit) {
-                malloc_deallocate(allocation_ptr);
-                allocation_ptr = nullptr;
-            }
-        };
-        // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        auto allocation = new (allocation_ptr) allocation_object(count);
-        BOOST_SCOPE_EXIT_ALL(&) {
-            if (!commit) {
-                allocation->~allocation_object();
+    // Returns nullptr if a new block could not be allocated.
+    void *allocate(std::size_t count) noexcept {
+        auto aligned_count = aligned_size(count);
+        if (m_blocks == nullptr || aligned_count > m_blocks->size - m_blocks->used) {
+            auto size = std::max(m_block_size, aligned_count);
+            void *memory = malloc_allocate(sizeof(block) + size, std::nothrow);
+            if (memory == nullptr) {
+                return nullptr;
             }
-        };
-
-        void *user_ptr = &allocation->ptr;
-        DEV_NEW_ASSERT(m_pointers.count(user_ptr) == 0);
-        m_pointers.insert(user_ptr);
+            m_blocks = new (memory) block{m_blocks, size, 0};
+            m_counters.reserved_size += size;
+            ++m_counters.blocks;
+        }
+        void *ptr = m_blocks->data() + m_blocks->used;
+        m_blocks->used += aligned_count;
+        return ptr;
+    }
 
-        commit = true;
-        ++m_total_allocations;
-        m_allocated_size += count;
-        m_max_allocated_size = std::max(m_max_allocated_size, m_allocated_size);
-        return user_ptr;
+    void account(std::size_t count) noexcept {
+        ++m_counters.allocations;
+        m_counters.allocated_size += count;
     }
 
-    void deallocate(void *ptr) noexcept {
-        if (!is_valid()) {
-            return;
+    bool contains(void const *ptr) const noexcept {
+        for (auto b = m_blocks; b != nullptr; b = b->next) {
+            if (!std::less<void const *>()(ptr, b->data()) && std::less<void const *>()(ptr, b->data() + b->used)) {
+                return true;
+            }
         }
+        return false;
+    }
 
-        lock_guard lock(m_mutex);
-        if (ptr != nullptr && m_pointers.erase(ptr) != 0) {
-            auto user_ptr = static_cast<std::size_t *>(ptr);
-            auto allocation = boost::intrusive::get_parent_from_member(user_ptr, &allocation_object::ptr);
-            DEV_NEW_ASSERT(allocation->count <= m_allocated_size);
-            m_allocated_size -= allocation->count;
-            void *allocation_ptr = allocation;
-            allocation->~allocation_object();
-            malloc_deallocate(allocation_ptr);
+    // Calls a function with each allocation object of the region (live or not).
+    template <typename Allocation, typename F> void for_each_allocation(F const &f) noexcept {
+        for (auto b = m_blocks; b != nullptr; b = b->next) {
+            for (std::size_t offset = 0; offset < b->used;) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                auto allocation = reinterpret_cast<Allocation *>(b->data() + offset);
+                offset += aligned_size(sizeof(Allocation) + allocation->count);
+                f(allocation);
+            }
         }
     }
 
-    void check_allocation(void *ptr) {
-        if (!is_valid()) {
-            return;
+    arena_counters const &counters() const noexcept { return m_counters; }
+    // Bytes of the arena and of the headers of its blocks.
+    std::size_t metadata_size() const noexcept { return sizeof(arena) + m_counters.blocks * sizeof(block); }
+
+    // Next arena in the list of live arenas of the manager.
+    arena *next{};
+    // Set once the scope of the arena has ended with live allocations: the region is kept until they are deallocated.
+    bool detached{};
+    std::uint64_t detached_allocations{};
+
+  private:
+    struct alignas(std::max_align_t) block {
+        block *next;
+        std::size_t size;
+        std::size_t used;
+
+        unsigned char *data() const noexcept {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, cppcoreguidelines-pro-type-const-cast)
+            return reinterpret_cast<unsigned char *>(const_cast<block *>(this) + 1);
         }
+    };
+
+    static std::size_t aligned_size(std::size_t count) noexcept {
+        auto const alignment = alignof(std::max_align_t);
+        return (count + alignment - 1) / alignment * alignment;
+    }
+
+    std::size_t m_block_size;
+    block *m_blocks{};
+    arena_counters m_counters{};
+};
+
+// Arena of the innermost arena scope of the current thread (nullptr if none).
+thread_local arena *current_arena = nullptr;
+
+// Operations table (used under the manager lock).
+class operation_table {
+  public:
+    constexpr operation_table() noexcept = default;
 
-        lock_guard lock(m_mutex);
-        if (m_pointers.count(ptr) == 0) {
-            throw std::domain_error("dev_new: pointer not allocated by this allocator");
+    // Returns 0 if all the slots are in use.
+    std::uint32_t add() noexcept {
+        for (std::size_t i = 0; i != max_operations; ++i) {
+            auto index = (m_next + i) % max_operations;
+            auto &slot = m_slots.at(index);
+            if (!slot.in_use) {
+                m_next = index + 1;
+                slot.in_use = true;
+                slot.statistics = operation_statistics{};
+                // Generation 0 is skipped, so that no id is 0.
+                if (++slot.generation == 1U << (32U - operation_index_bits)) {
+                    slot.generation = 1;
+                }
+                return slot.generation << operation_index_bits | static_cast<std::uint32_t>(index);
+            }
         }
+        return 0;
     }
 
-    bool check_allocation(void *ptr, std::nothrow_t const & /*unused*/) noexcept {
-        if (!is_valid()) {
-            return false;
+    operation_statistics remove(std::uint32_t id) noexcept {
+        auto slot = find_slot(id);
+        if (slot == nullptr) {
+            return operation_statistics{};
         }
+        slot->in_use = false;
+        return slot->statistics;
+    }
 
-        lock_guard lock(m_mutex);
-        return m_pointers.count(ptr) != 0;
+    // Returns nullptr if the operation has been removed.
+    operation_statistics *find(std::uint32_t id) noexcept {
+        auto slot = find_slot(id);
+        return slot != nullptr ? &slot->statistics : nullptr;
     }
 
   private:
-    std::uint64_t const valid_key = 0x123456789ABCDEFULL;
+    struct operation_slot {
+        std::uint32_t generation;
+        bool in_use;
+        operation_statistics statistics;
+    };
 
-    memory_manager()
-        : m_valid_key{valid_key}, m_total_allocations{}, m_allocated_size{}, m_max_allocated_size{}, m_error_testing{},
-          m_error_countdown{UINT64_MAX}, m_error_allocated_size{UINT64_MAX} {}
+    operation_slot *find_slot(std::uint32_t id) noexcept {
+        if (id == 0) {
+            return nullptr;
+        }
+        auto &slot = m_slots.at(id & (max_operations - 1));
+        if (!slot.in_use || slot.generation != id >> operation_index_bits) {
+            return nullptr;
+        }
+        return &slot;
+    }
 
-    ~memory_manager() { m_valid_key = 0; }
+    std::array<operation_slot, max_operations> m_slots{};
+    std::size_t m_next{};
+};
 
-    bool is_valid() const { return valid_key == m_valid_key; }
+// Set while the current thread is running inside the memory manager (i.e. holding its lock).
+thread_local bool inside_manager = false;
 
-    void error_point_implementation(std::size_t count) {
-        if (m_error_testing) {
-            if (m_error_countdown > 1) {
-                --m_error_countdown;
-            } else if (m_error_countdown == 1) {
-                m_error_allocated_size = m_allocated_size;
-                m_error_countdown = 0;
-                throw std::bad_alloc();
-            } else if (m_allocated_size + count > m_error_allocated_size) {
-                throw std::bad_alloc();
-            }
+// Static arena for the allocations that can't be made by the memory manager because the current thread is already
+// running inside it (e.g. an allocation made by code the manager runs while it is locked).
+// Its memory is never reused, deallocating a bootstrap allocation only updates the allocation statistics.
+class bootstrap_arena {
+  public:
+    static std::size_t const size = 64U * 1024U;
+
+    constexpr bootstrap_arena() noexcept = default;
+
+    void *allocate(std::size_t count) noexcept {
+        auto const alignment = alignof(std::max_align_t);
+        auto aligned_count = (count + alignment - 1) / alignment * alignment;
+        auto offset = m_used.fetch_add(aligned_count, std::memory_order_relaxed);
+        if (offset > size || aligned_count > size - offset) {
+            return nullptr;
         }
+        return &m_memory.at(offset);
     }
 
-    using pointer_set = std::unordered_set<void *, std::hash<void *>, std::equal_to<>, mallocator<void *>>;
-    using lock_guard = std::lock_guard<std::mutex>;
-
-    mutable std::uint64_t volatile m_valid_key;
-    mutable std::mutex m_mutex;
-    pointer_set m_pointers;
-    std::uint64_t m_total_allocations;
-    std::uint64_t m_allocated_size;
-    std::uint64_t m_max_allocated_size;
+    bool contains(void const *ptr) const noexcept {
+        return !(std::less<void const *>()(ptr, m_memory.data()) ||
+                 !std::less<void const *>()(ptr, m_memory.data() + size));
+    }
 
-    bool m_error_testing;
-    std::uint64_t m_error_countdown;
-    std::uint64_t m_error_allocated_size;
+  private:
+    alignas(std::max_align_t) std::array<unsigned char, size> m_memory{};
+    std::atomic<std::size_t> m_used{};
 };
 
-} // namespace detail
-
-std::uint64_t total_allocations() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->total_allocations();
+std::size_t bit_width(std::uint64_t value) noexcept {
+#if BOOST_COMP_GNUC || BOOST_COMP_CLANG
+    return value == 0 ? 0 : 64 - static_cast<std::size_t>(__builtin_clzll(value));
+#else
+    std::size_t width = 0;
+    for (; value != 0; value >>= 1U) {
+        ++width;
     }
-    return 0;
+    return width;
+#endif
 }
 
-std::uint64_t live_allocations() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->live_allocations();
+// Returns the bucket of a value in a log-scale histogram (its bit width, saturated to the last bucket).
+std::size_t log2_bucket(std::uint64_t value) noexcept { return std::min(bit_width(value), lifetime_buckets - 1); }
+
+// Returns the bucket of a value in a log-linear histogram (see latency_histogram).
+std::size_t latency_bucket(std::uint64_t value) noexcept {
+    if (value < 8) {
+        return static_cast<std::size_t>(value);
     }
-    return 0;
+    auto width = bit_width(value);
+    auto sub_bucket = static_cast<std::size_t>(value >> (width - 3)) & 3U;
+    return 8 + (width - 4) * 4 + sub_bucket;
 }
 
-std::uint64_t max_allocated_size() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->max_allocated_size();
-    }
-    return 0;
+std::uint64_t now_nanoseconds() noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
 }
 
-std::uint64_t allocated_size() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->allocated_size();
-    }
-    return 0;
+// Self profiling (see self_profile()).
+// \{
+std::atomic<bool> self_profiling{};
+
+// Time stamp counter (or steady clock nanoseconds).
+std::uint64_t now_ticks() noexcept {
+#if BOOST_ARCH_X86
+    return __rdtsc();
+#else
+    return now_nanoseconds();
+#endif
 }
 
-void set_error_countdown(std::uint64_t countdown) noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        m->set_error_countdown(countdown);
+struct self_profile_data {
+    std::array<latency_recorder, profiled_operations> operations;
+    latency_recorder lock_wait_nanoseconds;
+    // Clocks when self profiling was enabled (to measure the time stamp counter frequency).
+    std::atomic<std::uint64_t> start_ticks;
+    std::atomic<std::uint64_t> start_nanoseconds;
+};
+
+self_profile_data profile_data{};
+
+// Records the latency of a manager operation while self profiling.
+class operation_timer {
+  public:
+    explicit operation_timer(profiled_operation operation) noexcept
+        : m_operation{operation}, m_start{self_profiling.load(std::memory_order_relaxed) ? now_ticks() : 0} {}
+    ~operation_timer() {
+        if (m_start != 0) {
+            profile_data.operations.at(static_cast<std::size_t>(m_operation)).record(now_ticks() - m_start);
+        }
     }
+
+    operation_timer(operation_timer const & /*unused*/) = delete;
+    operation_timer(operation_timer && /*unused*/) = delete;
+    operation_timer &operator=(operation_timer const & /*unused*/) = delete;
+    operation_timer &operator=(operation_timer && /*unused*/) = delete;
+
+  private:
+    profiled_operation m_operation;
+    std::uint64_t m_start;
+};
+// \}
+
+// Latency injection (see set_latency_injection()).
+// The policy, the random generator and the counters are protected by the mutex.
+// \{
+std::atomic<bool> latency_injection_enabled{};
+std::mutex latency_injection_mutex;
+latency_injection_policy latency_injection{};
+latency_injection_counters latency_injection_totals{};
+std::uint64_t latency_injection_random{};
+std::uint64_t latency_injection_allocations{};
+
+// SplitMix64 generator.
+std::uint64_t next_random(std::uint64_t &state) noexcept {
+    auto value = (state += 0x9E3779B97F4A7C15ULL);
+    value = (value ^ (value >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27U)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31U);
 }
 
-std::uint64_t get_error_countdown() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->get_error_countdown();
-    }
-    return 0;
+// Returns a random value in [0, bound].
+std::uint64_t random_up_to(std::uint64_t bound) noexcept {
+    auto value = next_random(latency_injection_random);
+    return bound == std::numeric_limits<std::uint64_t>::max() ? value : value % (bound + 1);
 }
 
-void pause_error_testing() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        m->pause_error_testing();
+// Returns the delay of an allocation (0 if it isn't delayed).
+std::uint64_t injected_delay(std::size_t count) noexcept {
+    std::lock_guard<std::mutex> lock(latency_injection_mutex);
+    auto const &policy = latency_injection;
+    if (count < policy.min_size || latency_injection_allocations++ % std::max<std::uint64_t>(policy.period, 1) != 0) {
+        return 0;
+    }
+    std::uint64_t delay = 0;
+    switch (policy.distribution) {
+    case delay_distribution::fixed:
+        delay = policy.max_delay_nanoseconds;
+        break;
+    case delay_distribution::uniform:
+        delay = random_up_to(policy.max_delay_nanoseconds);
+        break;
+    case delay_distribution::recorded:
+        if (policy.recorded.count != 0) {
+            // A random bucket weighted by its count, then a random delay of the bucket.
+            auto rank = random_up_to(policy.recorded.count - 1);
+            std::size_t bucket = 0;
+            for (; bucket != latency_buckets - 1 && rank >= policy.recorded.buckets.at(bucket); ++bucket) {
+                rank -= policy.recorded.buckets.at(bucket);
+            }
+            delay = latency_bucket_lower_bound(bucket);
+            if (bucket != latency_buckets - 1) {
+                delay += random_up_to(latency_bucket_lower_bound(bucket + 1) - delay - 1);
+            }
+        }
+        break;
     }
+    ++latency_injection_totals.delayed_allocations;
+    latency_injection_totals.total_delay_nanoseconds += delay;
+    latency_injection_totals.max_delay_nanoseconds = std::max(latency_injection_totals.max_delay_nanoseconds, delay);
+    return delay;
 }
 
-void resume_error_testing() noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        m->resume_error_testing();
+// Delays an allocation according to the latency injection policy.
+void delay_allocation(std::size_t count) noexcept {
+    if (!latency_injection_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    auto delay = injected_delay(count);
+    if (delay >= 100000) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+    } else if (delay != 0) {
+        for (auto end = now_nanoseconds() + delay; now_nanoseconds() < end;) {
+        }
     }
 }
+// \}
 
-void error_point() { detail::memory_manager::instance().error_point(); }
+// Allocation events (see register_observer()).
+// Every publishing thread has a single-producer single-consumer ring of events. The rings are pushed on a lock-free
+// list read by the consumer thread of the event dispatcher, which frees the rings of the finished threads once they
+// are drained (except the head of the list, where the new rings are pushed).
+// \{
+std::atomic<bool> observing_events{};
+// Set on the consumer thread and while the observers run: their allocations don't publish events.
+thread_local bool inside_observer = false;
 
-void *allocate(std::size_t count, std::nothrow_t const & /*unused*/) noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->allocate(count, std::nothrow);
-    }
-    return nullptr;
-}
+class event_buffer {
+  public:
+    static constexpr std::size_t capacity = 1024;
 
-void *allocate(std::size_t count) { return detail::memory_manager::instance().allocate(count); }
+    explicit event_buffer(std::uint64_t thread) noexcept : m_thread{thread} {}
 
-void deallocate(void *ptr) noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        m->deallocate(ptr);
+    // Called by the publishing thread.
+    // Returns the number of queued events, 0 if the ring is full and the event is dropped.
+    std::uint64_t push(allocation_event const &event) noexcept {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        m_events.at(tail % capacity) = event;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return tail + 1 - m_head.load(std::memory_order_relaxed);
     }
-}
 
-void check_allocation(void *ptr) {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        m->check_allocation(ptr);
+    // Called by the consumer thread with each queued event.
+    // Returns the number of consumed events.
+    template <typename F> std::uint64_t drain(F const &f) noexcept {
+        auto head = m_head.load(std::memory_order_relaxed);
+        auto tail = m_tail.load(std::memory_order_acquire);
+        for (auto i = head; i != tail; ++i) {
+            auto event = m_events.at(i % capacity);
+            event.thread = m_thread;
+            f(event);
+        }
+        m_head.store(tail, std::memory_order_release);
+        return tail - head;
     }
-}
 
-bool check_allocation(void *ptr, std::nothrow_t const & /*unused*/) noexcept {
-    if (auto m = detail::memory_manager::instance(std::nothrow)) {
-        return m->check_allocation(ptr, std::nothrow);
-    }
-    return false;
-}
+    std::uint64_t published() const noexcept { return m_tail.load(std::memory_order_relaxed); }
+    std::uint64_t dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
 
-} // namespace dev_new
+    // Set once the publishing thread finished.
+    std::atomic<bool> finished{};
+    // Written before the buffer is pushed on the list, then by the consumer thread only.
+    event_buffer *next{};
+
+  private:
+    // The events are between the counters of the publishing thread and the head, so they don't share a cache line.
+    std::atomic<std::uint64_t> m_tail{};
+    std::atomic<std::uint64_t> m_dropped{};
+    std::array<allocation_event, capacity> m_events{};
+    std::atomic<std::uint64_t> m_head{};
+    std::uint64_t m_thread;
+};
+
+std::atomic<event_buffer *> event_buffers{};
+std::atomic<std::uint64_t> event_buffer_count{};
 
-void *operator new(std::size_t count) { return dev_new::allocate(count); }
-void *operator new[](std::size_t count) { return dev_new::allocate(count); }
-void *operator new(std::size_t count, std::align_val_t /*unused*/) { return dev_new::allocate(count); }
-void *operator new[](std::size_t count, std::align_val_t /*unused*/) { return dev_new::allocate(count); }
+// Event buffer of a thread, added on the thread's first event.
+class thread_event_buffer {
+  public:
+    thread_event_buffer() noexcept = default;
+    ~thread_event_buffer() {
+        if (m_buffer != nullptr) {
+            m_buffer->finished.store(true, std::memory_order_release);
+            m_buffer = nullptr;
+        }
+        thread_finished = true;
+    }
+
+    thread_event_buffer(thread_event_buffer const & /*unused*/) = delete;
+    thread_event_buffer(thread_event_buffer && /*unused*/) = delete;
+    thread_event_buffer &operator=(thread_event_buffer const & /*unused*/) = delete;
+    thread_event_buffer &operator=(thread_event_buffer && /*unused*/) = delete;
+
+    // Returns nullptr if the buffer could not be allocated or if the thread is finishing.
+    event_buffer *get() noexcept {
+        if (thread_finished) {
+            return nullptr;
+        }
+        if (m_buffer == nullptr) {
+            void *memory = malloc_allocate(sizeof(event_buffer), std::nothrow);
+            if (memory == nullptr) {
+                return nullptr;
+            }
+            // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+            m_buffer = new (memory) event_buffer(event_buffer_count.fetch_add(1, std::memory_order_relaxed));
+            m_buffer->next = event_buffers.load(std::memory_order_relaxed);
+            while (!event_buffers.compare_exchange_weak(m_buffer->next, m_buffer, std::memory_order_release,
+                                                        std::memory_order_relaxed)) {
+            }
+        }
+        return m_buffer;
+    }
+
+  private:
+    event_buffer *m_buffer{};
+    // Set by the destructor: once finished, the buffer may be freed by the consumer thread (see
+    // handler_cache::thread_finished).
+    static thread_local bool thread_finished;
+};
+
+thread_local bool thread_event_buffer::thread_finished = false;
+thread_local thread_event_buffer current_event_buffer;
+
+// Wakes the consumer thread before the rings fill up.
+std::condition_variable event_consumer_wakeup;
+
+// Publishes an event to the ring of the current thread (while an observer is registered).
+void publish_event(allocation_event_type type, void const *ptr, std::uint64_t size, void const *site) noexcept {
+    if (!observing_events.load(std::memory_order_relaxed) || inside_observer) {
+        return;
+    }
+    if (auto buffer = current_event_buffer.get()) {
+        if (buffer->push(allocation_event{type, ptr, size, site, now_nanoseconds(), 0}) == event_buffer::capacity / 2) {
+            event_consumer_wakeup.notify_one();
+        }
+    }
+}
+
+// Consumer thread delivering the events to the observers.
+// The observers and the list of buffers are protected by the delivery mutex, held while the observers run. The
+// lifecycle mutex serializes the registrations with the start and the stop of the thread.
+class event_dispatcher {
+  public:
+    event_dispatcher() = default;
+    ~event_dispatcher() { stop(); }
+
+    event_dispatcher(event_dispatcher const & /*unused*/) = delete;
+    event_dispatcher(event_dispatcher && /*unused*/) = delete;
+    event_dispatcher &operator=(event_dispatcher const & /*unused*/) = delete;
+    event_dispatcher &operator=(event_dispatcher && /*unused*/) = delete;
+
+    std::size_t add(allocation_observer observer, void *context) {
+        std::lock_guard<std::mutex> lifecycle_lock(m_lifecycle_mutex);
+        std::size_t id = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_delivery_mutex);
+            for (std::size_t i = 0; i != max_allocation_observers && id == 0; ++i) {
+                if (m_observers.at(i).observer == nullptr) {
+                    m_observers.at(i) = observer_entry{observer, context};
+                    ++m_observer_count;
+                    id = i + 1;
+                }
+            }
+        }
+        if (id != 0 && !m_thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = false;
+            }
+            try {
+                m_thread = std::thread([this] { run(); });
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m_delivery_mutex);
+                m_observers.at(id - 1) = observer_entry{};
+                --m_observer_count;
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = true;
+            observing_events.store(true, std::memory_order_relaxed);
+        }
+        return id;
+    }
+
+    void remove(std::size_t id) {
+        std::lock_guard<std::mutex> lifecycle_lock(m_lifecycle_mutex);
+        {
+            std::lock_guard<std::mutex> lock(m_delivery_mutex);
+            if (id == 0 || id > max_allocation_observers || m_observers.at(id - 1).observer == nullptr) {
+                return;
+            }
+            m_observers.at(id - 1) = observer_entry{};
+            if (--m_observer_count != 0) {
+                return;
+            }
+        }
+        stop_thread();
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lifecycle_lock(m_lifecycle_mutex);
+        {
+            std::lock_guard<std::mutex> lock(m_delivery_mutex);
+            m_observers = {};
+            m_observer_count = 0;
+        }
+        stop_thread();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        // The second pass from now starts after the call, so it drains the events published before it.
+        auto passes = m_passes + 2;
+        ++m_flushing;
+        event_consumer_wakeup.notify_one();
+        m_passed.wait(lock, [&] { return m_passes >= passes || !m_running; });
+        --m_flushing;
+    }
+
+    allocation_event_counters statistics() const noexcept {
+        std::lock_guard<std::mutex> lock(m_delivery_mutex);
+        auto counters = m_freed;
+        counters.delivered_events = m_delivered;
+        for (auto buffer = event_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+            counters.published_events += buffer->published();
+            counters.dropped_events += buffer->dropped();
+        }
+        return counters;
+    }
+
+  private:
+    struct observer_entry {
+        allocation_observer observer;
+        void *context;
+    };
+
+    void run() {
+        inside_observer = true;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop) {
+            lock.unlock();
+            deliver();
+            lock.lock();
+            ++m_passes;
+            m_passed.notify_all();
+            if (!m_stop && m_flushing == 0) {
+                event_consumer_wakeup.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    // Drains the buffers (the events are dropped when there is no observer).
+    void deliver() noexcept {
+        std::lock_guard<std::mutex> lock(m_delivery_mutex);
+        event_buffer *previous = nullptr;
+        for (auto buffer = event_buffers.load(std::memory_order_acquire); buffer != nullptr;) {
+            auto next = buffer->next;
+            // Read before draining: the events published before the thread finished are drained.
+            auto finished = buffer->finished.load(std::memory_order_acquire);
+            auto delivered = buffer->drain([this](allocation_event const &event) {
+                for (auto const &entry : m_observers) {
+                    if (entry.observer != nullptr) {
+                        entry.observer(event, entry.context);
+                    }
+                }
+            });
+            if (m_observer_count != 0) {
+                m_delivered += delivered;
+            }
+            if (finished && previous != nullptr) {
+                previous->next = next;
+                m_freed.published_events += buffer->published();
+                m_freed.dropped_events += buffer->dropped();
+                buffer->~event_buffer();
+                malloc_deallocate(buffer);
+            } else {
+                previous = buffer;
+            }
+            buffer = next;
+        }
+    }
+
+    void stop_thread() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_thread.joinable()) {
+                return;
+            }
+            observing_events.store(false, std::memory_order_relaxed);
+            m_stop = true;
+        }
+        event_consumer_wakeup.notify_all();
+        m_thread.join();
+        // Drops the events left in the buffers, they aren't delivered to the next observers.
+        deliver();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_passed.notify_all();
+    }
+
+    std::mutex m_lifecycle_mutex;
+    mutable std::mutex m_delivery_mutex;
+    std::array<observer_entry, max_allocation_observers> m_observers{};
+    std::size_t m_observer_count{};
+    std::uint64_t m_delivered{};
+    // Counters of the freed buffers.
+    allocation_event_counters m_freed{};
+
+    std::mutex m_mutex;
+    std::condition_variable m_passed;
+    bool m_stop{};
+    bool m_running{};
+    std::uint64_t m_passes{};
+    unsigned m_flushing{};
+    std::thread m_thread;
+};
+
+event_dispatcher event_observers;
+// \}
+
+// Lifetime histograms per size class and per call site (updated under the manager lock).
+// The sites are kept in a fixed-size hash table; once it is full, the lifetimes of new sites are added to the entry of
+// the unknown site (nullptr).
+class lifetime_table {
+  public:
+    static constexpr std::size_t max_sites = 1024;
+    static constexpr std::size_t max_top_sites = 64;
+
+    constexpr lifetime_table() noexcept = default;
+
+    void record(void const *site, std::size_t count, std::uint64_t nanoseconds, std::uint64_t ticks) noexcept {
+        add(m_size_classes.at(log2_bucket(count)), nanoseconds, ticks);
+        add(site_lifetimes(site), nanoseconds, ticks);
+    }
+
+    lifetime_statistics const &size_class(std::size_t size_class) const noexcept {
+        return m_size_classes.at(size_class);
+    }
+
+    // Copies the statistics of the sites with deallocations (at most max_count).
+    std::size_t copy_sites(site_lifetime_statistics *sites, std::size_t max_count) const noexcept {
+        std::size_t count = 0;
+        if (m_unknown_site.deallocations != 0 && count != max_count) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            sites[count++] = site_lifetime_statistics{nullptr, m_unknown_site};
+        }
+        for (auto const &entry : m_sites) {
+            if (entry.site != nullptr && count != max_count) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                sites[count++] = entry;
+            }
+        }
+        return count;
+    }
+
+    // Copies the statistics of the sites with the most deallocations, the most first (at most max_count, up to
+    // max_top_sites).
+    // The sites are selected by reference, so that only the copied ones are read in full.
+    std::size_t copy_top_sites(site_lifetime_statistics *sites, std::size_t max_count) const noexcept {
+        struct candidate {
+            void const *site;
+            lifetime_statistics const *lifetimes;
+        };
+        // Min-heap of the selected sites on their deallocations.
+        std::array<candidate, max_top_sites> top{};
+        auto more_deallocations = [](candidate const &a, candidate const &b) {
+            return a.lifetimes->deallocations > b.lifetimes->deallocations;
+        };
+        max_count = std::min(max_count, max_top_sites);
+        std::size_t count = 0;
+        auto select = [&](void const *site, lifetime_statistics const &lifetimes) {
+            if (lifetimes.deallocations == 0 || max_count == 0) {
+                return;
+            }
+            if (count != max_count) {
+                top.at(count++) = candidate{site, &lifetimes};
+                std::push_heap(top.begin(), top.begin() + count, more_deallocations);
+            } else if (lifetimes.deallocations > top.front().lifetimes->deallocations) {
+                std::pop_heap(top.begin(), top.begin() + count, more_deallocations);
+                top.at(count - 1) = candidate{site, &lifetimes};
+                std::push_heap(top.begin(), top.begin() + count, more_deallocations);
+            }
+        };
+        select(nullptr, m_unknown_site);
+        for (auto const &entry : m_sites) {
+            if (entry.site != nullptr) {
+                select(entry.site, entry.lifetimes);
+            }
+        }
+        std::sort_heap(top.begin(), top.begin() + count, more_deallocations);
+        for (std::size_t i = 0; i != count; ++i) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            sites[i] = site_lifetime_statistics{top.at(i).site, *top.at(i).lifetimes};
+        }
+        return count;
+    }
+
+    std::size_t site_count() const noexcept { return m_site_count + 1; }
+
+  private:
+    static void add(lifetime_statistics &statistics, std::uint64_t nanoseconds, std::uint64_t ticks) noexcept {
+        ++statistics.deallocations;
+        ++statistics.nanoseconds.at(log2_bucket(nanoseconds));
+        ++statistics.ticks.at(log2_bucket(ticks));
+    }
+
+    lifetime_statistics &site_lifetimes(void const *site) noexcept {
+        if (site == nullptr) {
+            return m_unknown_site;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto value = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(site));
+        auto index = static_cast<std::size_t>((value * 0x9E3779B97F4A7C15ULL) >> 54U);
+        for (;; index = (index + 1) % max_sites) {
+            auto &entry = m_sites.at(index);
+            if (entry.site == site) {
+                return entry.lifetimes;
+            }
+            if (entry.site == nullptr) {
+                // The table is kept at most half full.
+                if (2 * (m_site_count + 1) > max_sites) {
+                    return m_unknown_site;
+                }
+                ++m_site_count;
+                entry.site = site;
+                return entry.lifetimes;
+            }
+        }
+    }
+
+    std::array<lifetime_statistics, lifetime_buckets> m_size_classes{};
+    std::array<site_lifetime_statistics, max_sites> m_sites{};
+    lifetime_statistics m_unknown_site{};
+    std::size_t m_site_count{};
+};
+
+// Lifetime table of the feature policies without lifetimes: nothing is recorded.
+class no_lifetime_table {
+  public:
+    void record(void const * /*unused*/, std::size_t /*unused*/, std::uint64_t /*unused*/,
+                std::uint64_t /*unused*/) noexcept {}
+
+    lifetime_statistics const &size_class(std::size_t /*unused*/) const noexcept {
+        static lifetime_statistics const empty{};
+        return empty;
+    }
+
+    std::size_t copy_sites(site_lifetime_statistics * /*unused*/, std::size_t /*unused*/) const noexcept { return 0; }
+    std::size_t copy_top_sites(site_lifetime_statistics * /*unused*/, std::size_t /*unused*/) const noexcept {
+        return 0;
+    }
+
+    std::size_t site_count() const noexcept { return 0; }
+};
+
+// Growth steps per call site (see growth_sites()).
+// The deallocations may be made without the manager lock (see push_remote_free()), so the table is updated with
+// atomic operations. Once half of it is used, the steps of the new sites are added to the entry of the unknown site.
+class growth_table {
+  public:
+    static constexpr std::size_t max_sites = 1024;
+
+    constexpr growth_table() noexcept = default;
+
+    void record(void const *site, std::uint64_t old_size, std::uint64_t new_size) noexcept {
+        auto &entry = site_entry(site);
+        entry.growth_steps.fetch_add(1, std::memory_order_relaxed);
+        entry.copied_size.fetch_add(old_size, std::memory_order_relaxed);
+        auto max_size = entry.max_size.load(std::memory_order_relaxed);
+        while (new_size > max_size &&
+               !entry.max_size.compare_exchange_weak(max_size, new_size, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Calls a function with each site with growth steps.
+    template <typename F> void for_each(F const &f) const {
+        auto call = [&](void const *site, entry const &entry) {
+            auto growth_steps = entry.growth_steps.load(std::memory_order_relaxed);
+            if (growth_steps != 0) {
+                f(growth_site{site, growth_steps, entry.copied_size.load(std::memory_order_relaxed),
+                              entry.max_size.load(std::memory_order_relaxed)});
+            }
+        };
+        call(nullptr, m_unknown_site);
+        for (auto const &entry : m_sites) {
+            if (auto site = entry.site.load(std::memory_order_acquire)) {
+                call(site, entry);
+            }
+        }
+    }
+
+  private:
+    struct entry {
+        std::atomic<void const *> site;
+        std::atomic<std::uint64_t> growth_steps;
+        std::atomic<std::uint64_t> copied_size;
+        std::atomic<std::uint64_t> max_size;
+    };
+
+    entry &site_entry(void const *site) noexcept {
+        if (site == nullptr) {
+            return m_unknown_site;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto value = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(site));
+        auto index = static_cast<std::size_t>((value * 0x9E3779B97F4A7C15ULL) >> 54U);
+        for (;; index = (index + 1) % max_sites) {
+            auto &entry = m_sites.at(index);
+            auto entry_site = entry.site.load(std::memory_order_acquire);
+            if (entry_site == site) {
+                return entry;
+            }
+            if (entry_site == nullptr) {
+                if (2 * m_site_count.load(std::memory_order_relaxed) >= max_sites) {
+                    return m_unknown_site;
+                }
+                if (entry.site.compare_exchange_strong(entry_site, site, std::memory_order_acq_rel)) {
+                    m_site_count.fetch_add(1, std::memory_order_relaxed);
+                    return entry;
+                }
+                if (entry_site == site) {
+                    return entry;
+                }
+            }
+        }
+    }
+
+    std::array<entry, max_sites> m_sites{};
+    entry m_unknown_site{};
+    std::atomic<std::size_t> m_site_count{};
+};
+
+growth_table growth_steps{};
+
+// Last allocation or deallocation of a thread (with stack capture), to detect the growth steps.
+struct growth_event {
+    void const *site;
+    std::uint64_t size;
+    bool allocation;
+};
+
+thread_local growth_event last_growth_event{};
+
+// Returns true if a block grows about one geometric step (1.5 to 2.5 times).
+bool is_growth_step(std::uint64_t old_size, std::uint64_t new_size) noexcept {
+    return old_size != 0 && 2 * new_size >= 3 * old_size && 2 * new_size <= 5 * old_size;
+}
+
+// Records an allocation or a deallocation of the current thread, counting it as a growth step if the previous event of
+// the thread is the other half of the step.
+void record_growth_event(void const *site, std::uint64_t size, bool allocation) noexcept {
+    auto &last = last_growth_event;
+    if (site != nullptr && last.site == site && last.allocation != allocation) {
+        auto old_size = allocation ? last.size : size;
+        auto new_size = allocation ? size : last.size;
+        if (is_growth_step(old_size, new_size)) {
+            growth_steps.record(site, old_size, new_size);
+        }
+    }
+    last = growth_event{site, size, allocation};
+}
+
+#if BOOST_OS_LINUX
+// Growable stack of indices (allocated with malloc).
+class index_stack {
+  public:
+    index_stack() noexcept = default;
+    ~index_stack() { malloc_deallocate(m_indices); }
+
+    index_stack(index_stack const & /*unused*/) = delete;
+    index_stack(index_stack && /*unused*/) = delete;
+    index_stack &operator=(index_stack const & /*unused*/) = delete;
+    index_stack &operator=(index_stack && /*unused*/) = delete;
+
+    bool empty() const noexcept { return m_size == 0; }
+    std::size_t size() const noexcept { return m_size; }
+
+    // Returns false if the stack could not grow.
+    bool push(std::size_t index) noexcept {
+        if (m_size == m_capacity) {
+            auto capacity = std::max<std::size_t>(m_capacity * 2, 256);
+            auto indices = malloc_allocate<std::size_t>(capacity, std::nothrow);
+            if (indices == nullptr) {
+                return false;
+            }
+            std::copy_n(m_indices, m_size, indices);
+            malloc_deallocate(m_indices);
+            m_indices = indices;
+            m_capacity = capacity;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        m_indices[m_size++] = index;
+        return true;
+    }
+
+    std::size_t pop() noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        return m_indices[--m_size];
+    }
+
+    // Moves up to count indices to another stack.
+    // Returns false if the other stack could not grow (the index that could not be moved is kept).
+    bool move_to(index_stack &other, std::size_t count) noexcept {
+        for (; count != 0 && !empty(); --count) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (!other.push(m_indices[m_size - 1])) {
+                return false;
+            }
+            --m_size;
+        }
+        return true;
+    }
+
+  private:
+    std::size_t *m_indices{};
+    std::size_t m_size{};
+    std::size_t m_capacity{};
+};
+
+// Returns the number of threads of the process, 0 if it can't be read (without allocating).
+unsigned count_process_threads() noexcept {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg, hicpp-signed-bitwise)
+    int fd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
+    }
+    std::array<char, 4096> status{};
+    auto size = read(fd, status.data(), status.size() - 1);
+    close(fd);
+    if (size <= 0) {
+        return 0;
+    }
+    auto threads = std::strstr(status.data(), "\nThreads:");
+    if (threads == nullptr) {
+        return 0;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return static_cast<unsigned>(std::strtoul(threads + std::strlen("\nThreads:"), nullptr, 10));
+}
+
+// Conservative reachability scan of the live allocations (see find_leaks()).
+// The allocations are sorted by address, so that a word points into an allocation if a binary search finds it (the
+// interior pointers make an allocation reachable too). An index of the address range, split in as many buckets as
+// allocations, narrows each search to the allocations starting in the bucket of the word. The words are scanned in
+// batches: a branch-free (vectorizable) test of the address range filters the words before the searches.
+// The marking is shared by worker threads: each one scans the allocations of its own stack and shares them when the
+// others are waiting. The scanner allocates its buffers with malloc and its threads with pthread_create, so it can
+// run while the memory manager lock is held.
+// Only the roots of the calling thread are scanned, so the scan is not run while other threads are running.
+class leak_scanner {
+  public:
+    static constexpr unsigned max_threads = 64;
+
+    leak_scanner() noexcept = default;
+    ~leak_scanner() {
+        malloc_deallocate(m_blocks);
+        malloc_deallocate(m_marks);
+        malloc_deallocate(m_buckets);
+        malloc_deallocate(m_leaks);
+    }
+
+    leak_scanner(leak_scanner const & /*unused*/) = delete;
+    leak_scanner(leak_scanner && /*unused*/) = delete;
+    leak_scanner &operator=(leak_scanner const & /*unused*/) = delete;
+    leak_scanner &operator=(leak_scanner && /*unused*/) = delete;
+
+    // Returns false if the allocations could not be reserved.
+    bool reserve(std::size_t count) noexcept {
+        m_blocks = malloc_allocate<block>(std::max<std::size_t>(count, 1), std::nothrow);
+        m_marks = malloc_allocate<std::atomic<bool>>(std::max<std::size_t>(count, 1), std::nothrow);
+        return m_blocks != nullptr && m_marks != nullptr;
+    }
+
+    // Counts the threads of the process other than the calling one.
+    // Returns false if there are any: the scan would report the allocations only they refer to.
+    bool check_other_threads() noexcept {
+        m_other_threads = std::max(count_process_threads(), 1U) - 1;
+        return m_other_threads == 0;
+    }
+
+    // Adds a live allocation (up to the reserved count).
+    void add(void const *ptr, std::size_t count, void const *site) noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto begin = reinterpret_cast<std::uintptr_t>(ptr);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        m_blocks[m_count] = block{begin, begin + std::max<std::size_t>(count, 1), site};
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        new (&m_marks[m_count]) std::atomic<bool>{false};
+        ++m_count;
+    }
+
+    // Sorts and indexes the allocations, once they are all added.
+    // Returns false if the index could not be allocated.
+    bool prepare() noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        std::sort(m_blocks, m_blocks + m_count, [](block const &a, block const &b) { return a.begin < b.begin; });
+        if (m_count == 0) {
+            return true;
+        }
+        m_low = m_blocks[0].begin;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        m_span = m_blocks[m_count - 1].end - m_low;
+        while (((m_span - 1) >> m_bucket_shift) >= m_count) {
+            ++m_bucket_shift;
+        }
+        // Bucket b starts with the first allocation at or after m_low + (b << m_bucket_shift).
+        auto bucket_count = static_cast<std::size_t>(((m_span - 1) >> m_bucket_shift) + 1);
+        m_buckets = malloc_allocate<std::size_t>(bucket_count + 1, std::nothrow);
+        if (m_buckets == nullptr) {
+            return false;
+        }
+        std::size_t index = 0;
+        for (std::size_t bucket = 0; bucket != bucket_count; ++bucket) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            while (index != m_count && m_blocks[index].begin < m_low + (std::uintptr_t{bucket} << m_bucket_shift)) {
+                ++index;
+            }
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            m_buckets[bucket] = index;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        m_buckets[bucket_count] = m_count;
+        return true;
+    }
+
+    // Scans a root memory range.
+    void scan_root(void const *begin, std::size_t size) noexcept { scan(begin, size, m_pending); }
+
+    // Scans the roots of the calling thread and the data sections of the loaded modules.
+    // The inlining is prevented so that the registers are saved in the frame of this function, which is scanned with
+    // the stack of the calling thread.
+    __attribute__((noinline)) void scan_roots() noexcept {
+        std::jmp_buf registers;
+        // The callee-saved registers are saved in the buffer.
+        // NOLINTNEXTLINE(cert-err52-cpp)
+        setjmp(registers);
+        scan_root(&registers, sizeof(registers));
+
+        pthread_attr_t attributes;
+        if (pthread_getattr_np(pthread_self(), &attributes) == 0) {
+            void *stack = nullptr;
+            std::size_t stack_size = 0;
+            if (pthread_attr_getstack(&attributes, &stack, &stack_size) == 0) {
+                // From the frame of this function to the bottom of the stack.
+                auto top = static_cast<char const *>(static_cast<void const *>(&registers));
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                auto bottom = static_cast<char const *>(stack) + stack_size;
+                if (top >= stack && top < bottom) {
+                    scan_root(top, static_cast<std::size_t>(bottom - top));
+                }
+            }
+            pthread_attr_destroy(&attributes);
+        }
+
+        dl_iterate_phdr(
+            [](dl_phdr_info *info, std::size_t size, void *scanner) {
+                bool has_tls_data = size >= offsetof(dl_phdr_info, dlpi_tls_data) + sizeof(info->dlpi_tls_data);
+                for (std::size_t i = 0; i != info->dlpi_phnum; ++i) {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    auto const &header = info->dlpi_phdr[i];
+                    if (header.p_type == PT_LOAD && (header.p_flags & PF_W) != 0) {
+                        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+                        static_cast<leak_scanner *>(scanner)->scan_root(
+                            reinterpret_cast<void const *>(info->dlpi_addr + header.p_vaddr), header.p_memsz);
+                    } else if (header.p_type == PT_TLS && has_tls_data && info->dlpi_tls_data != nullptr) {
+                        // The thread-local storage of the calling thread.
+                        static_cast<leak_scanner *>(scanner)->scan_root(info->dlpi_tls_data, header.p_memsz);
+                    }
+                }
+                return 0;
+            },
+            this);
+    }
+
+    // Marks the allocations reachable from the roots (thread_count is 0 to pick the count).
+    // Returns false if a buffer could not be allocated.
+    bool mark(unsigned thread_count) noexcept {
+        if (thread_count == 0) {
+            thread_count = m_count < parallel_min_allocations ? 1 : std::thread::hardware_concurrency();
+        }
+        m_thread_count = std::min(std::max(thread_count, 1U), max_threads);
+        std::array<pthread_t, max_threads> threads{};
+        unsigned started = 1;
+        for (; started != m_thread_count; ++started) {
+            if (pthread_create(&threads.at(started), nullptr, &leak_scanner::run_worker, this) != 0) {
+                break;
+            }
+        }
+        if (started != m_thread_count) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_thread_count = started;
+        }
+        m_pending_changed.notify_all();
+        run_worker(this);
+        for (unsigned i = 1; i != started; ++i) {
+            pthread_join(threads.at(i), nullptr);
+        }
+        return !m_failed.load(std::memory_order_relaxed);
+    }
+
+    // Groups the unreachable allocations by site.
+    // Returns false if the groups could not be allocated.
+    bool collect_leaks() noexcept {
+        std::size_t leaked = 0;
+        for (std::size_t index = 0; index != m_count; ++index) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            leaked += m_marks[index].load(std::memory_order_relaxed) ? 0 : 1;
+        }
+        if (leaked == 0) {
+            return true;
+        }
+        m_leaks = malloc_allocate<leak_site>(leaked, std::nothrow);
+        if (m_leaks == nullptr) {
+            return false;
+        }
+        for (std::size_t index = 0; index != m_count; ++index) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            auto const &leaked_block = m_blocks[index];
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (!m_marks[index].load(std::memory_order_relaxed)) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                m_leaks[m_leak_count++] = leak_site{leaked_block.site, 1, leaked_block.end - leaked_block.begin};
+                ++m_leaked_allocations;
+                m_leaked_size += leaked_block.end - leaked_block.begin;
+            }
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto leaks_end = m_leaks + m_leak_count;
+        std::sort(m_leaks, leaks_end, [](leak_site const &a, leak_site const &b) { return a.site < b.site; });
+        std::size_t sites = 0;
+        for (auto leak = m_leaks; leak != leaks_end; ++leak) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (sites != 0 && m_leaks[sites - 1].site == leak->site) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                auto &group = m_leaks[sites - 1];
+                group.allocations += leak->allocations;
+                group.size += leak->size;
+            } else {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                m_leaks[sites++] = *leak;
+            }
+        }
+        m_leak_count = sites;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        std::sort(m_leaks, m_leaks + m_leak_count,
+                  [](leak_site const &a, leak_site const &b) { return a.size > b.size; });
+        return true;
+    }
+
+    std::size_t live_allocations() const noexcept { return m_count; }
+    std::uint64_t leaked_allocations() const noexcept { return m_leaked_allocations; }
+    std::uint64_t leaked_size() const noexcept { return m_leaked_size; }
+    std::uint64_t scanned_size() const noexcept { return m_scanned_size.load(std::memory_order_relaxed); }
+    unsigned thread_count() const noexcept { return m_thread_count; }
+    unsigned other_threads() const noexcept { return m_other_threads; }
+    leak_site const *leaks() const noexcept { return m_leaks; }
+    std::size_t leak_site_count() const noexcept { return m_leak_count; }
+
+  private:
+    // Number of live allocations from which the thread count picked by default is the hardware concurrency.
+    static constexpr std::size_t parallel_min_allocations = 1U << 16U;
+    static constexpr std::size_t batch_size = 16;
+    // Number of allocations a worker shares or takes at once.
+    static constexpr std::size_t share_size = 64;
+
+    struct block {
+        std::uintptr_t begin;
+        std::uintptr_t end;
+        void const *site;
+    };
+
+    static void *run_worker(void *scanner) noexcept {
+        index_stack found;
+        static_cast<leak_scanner *>(scanner)->work(found);
+        return nullptr;
+    }
+
+    // Scans the allocations of its stack until all the workers wait for pending allocations.
+    void work(index_stack &found) noexcept {
+        while (take(found)) {
+            while (!found.empty()) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                auto const &reached = m_blocks[found.pop()];
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+                scan(reinterpret_cast<void const *>(reached.begin), reached.end - reached.begin, found);
+                if (found.size() > share_size && m_waiting.load(std::memory_order_relaxed) != 0) {
+                    share(found);
+                }
+            }
+        }
+    }
+
+    // Takes pending allocations, waiting for them while other workers are scanning.
+    // Returns false once all the workers wait.
+    bool take(index_stack &found) noexcept {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_waiting;
+        m_pending_changed.wait(lock, [this] {
+            return !m_pending.empty() || m_waiting.load(std::memory_order_relaxed) == m_thread_count;
+        });
+        if (m_pending.empty()) {
+            m_pending_changed.notify_all();
+            return false;
+        }
+        --m_waiting;
+        if (!m_pending.move_to(found, share_size)) {
+            m_failed.store(true, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    void share(index_stack &found) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!found.move_to(m_pending, found.size() / 2)) {
+                m_failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        m_pending_changed.notify_all();
+    }
+
+    // Scans the aligned words of a memory range, adding the newly reached allocations to a stack.
+    void scan(void const *begin, std::size_t size, index_stack &found) noexcept {
+        m_scanned_size.fetch_add(size, std::memory_order_relaxed);
+        auto alignment = alignof(std::uintptr_t);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto first = (reinterpret_cast<std::uintptr_t>(begin) + alignment - 1) & ~(alignment - 1);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto last = (reinterpret_cast<std::uintptr_t>(begin) + size) & ~(alignment - 1);
+        if (m_count == 0 || first >= last) {
+            return;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+        auto word = reinterpret_cast<std::uintptr_t const *>(first);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+        auto words_end = reinterpret_cast<std::uintptr_t const *>(last);
+        for (; words_end - word >= static_cast<std::ptrdiff_t>(batch_size); word += batch_size) {
+            std::array<std::uintptr_t, batch_size> words{};
+            std::memcpy(words.data(), word, sizeof(words));
+            std::uint32_t candidates = 0;
+            for (std::size_t i = 0; i != batch_size; ++i) {
+                candidates |= static_cast<std::uint32_t>(words.at(i) - m_low < m_span) << i;
+            }
+            for (; candidates != 0; candidates &= candidates - 1) {
+                visit(words.at(static_cast<std::size_t>(__builtin_ctz(candidates))), found);
+            }
+        }
+        for (; word != words_end; ++word) {
+            if (*word - m_low < m_span) {
+                visit(*word, found);
+            }
+        }
+    }
+
+    // Marks the allocation a word points into (if any), adding it to a stack when newly reached.
+    void visit(std::uintptr_t word, index_stack &found) noexcept {
+        auto bucket = static_cast<std::size_t>((word - m_low) >> m_bucket_shift);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto next = std::upper_bound(m_blocks + m_buckets[bucket], m_blocks + m_buckets[bucket + 1], word,
+                                     [](std::uintptr_t value, block const &b) { return value < b.begin; });
+        if (next == m_blocks) {
+            return;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto index = static_cast<std::size_t>(next - m_blocks - 1);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto &mark = m_marks[index];
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        if (word >= m_blocks[index].end || mark.load(std::memory_order_relaxed) ||
+            mark.exchange(true, std::memory_order_relaxed)) {
+            return;
+        }
+        if (!found.push(index)) {
+            m_failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    block *m_blocks{};
+    std::atomic<bool> *m_marks{};
+    std::size_t m_count{};
+    std::uintptr_t m_low{};
+    std::uintptr_t m_span{};
+    std::size_t *m_buckets{};
+    unsigned m_bucket_shift{};
+
+    std::mutex m_mutex;
+    std::condition_variable m_pending_changed;
+    index_stack m_pending;
+    std::atomic<unsigned> m_waiting{};
+    unsigned m_thread_count{1};
+    std::atomic<bool> m_failed{};
+    std::atomic<std::uint64_t> m_scanned_size{};
+
+    leak_site *m_leaks{};
+    std::size_t m_leak_count{};
+    std::uint64_t m_leaked_allocations{};
+    std::uint64_t m_leaked_size{};
+    unsigned m_other_threads{};
+};
+#endif
+
+// Reads the resident and virtual size of the process (without allocating).
+void read_process_memory(overhead_counters &counters) noexcept {
+#if BOOST_OS_LINUX
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg, hicpp-signed-bitwise)
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    std::array<char, 128> statm{};
+    auto size = read(fd, statm.data(), statm.size() - 1);
+    close(fd);
+    if (size <= 0) {
+        return;
+    }
+    // The sizes are in pages: total program size, resident set size, ...
+    char *end = nullptr;
+    auto virtual_pages = std::strtoull(statm.data(), &end, 10);
+    auto resident_pages = std::strtoull(end, nullptr, 10);
+    auto page_size = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    counters.virtual_size = virtual_pages * page_size;
+    counters.resident_size = resident_pages * page_size;
+#else
+    static_cast<void>(counters);
+#endif
+}
+
+// Compile-time feature set of a memory manager.
+template <bool Tracking, bool ErrorInjection, bool Statistics, bool StackCapture, bool FillPatterns, bool Lifetimes>
+struct feature_policy {
+    static constexpr bool tracking = Tracking;
+    static constexpr bool error_injection = ErrorInjection;
+    static constexpr bool statistics = Statistics;
+    static constexpr bool stack_capture = StackCapture;
+    static constexpr bool fill_patterns = FillPatterns;
+    static constexpr bool lifetimes = Lifetimes;
+};
+
+using configured_features = feature_policy<DEV_NEW_TRACKING != 0, DEV_NEW_ERROR_INJECTION != 0,
+                                           DEV_NEW_STATISTICS != 0, DEV_NEW_STACK_CAPTURE != 0,
+                                           DEV_NEW_FILL_PATTERNS != 0, DEV_NEW_LIFETIMES != 0>;
+
+// Allocation memory manager.
+// It is constant-initialized and never destroyed (see memory_manager_storage), so that it can be used before main()
+// and while the static objects are destroyed.
+template <typename Features> class basic_memory_manager {
+  public:
+    using allocation_object = basic_allocation_object<Features>;
+    static_assert(offsetof(allocation_object, ptr) % alignof(std::max_align_t) == 0,
+                  "the user data of an allocation must be aligned as max_align_t");
+
+    static basic_memory_manager &instance() noexcept;
+
+    basic_memory_manager(basic_memory_manager const & /*unused*/) = delete;
+    basic_memory_manager(basic_memory_manager && /*unused*/) = delete;
+    basic_memory_manager &operator=(basic_memory_manager const & /*unused*/) = delete;
+    basic_memory_manager &operator=(basic_memory_manager && /*unused*/) = delete;
+
+    std::uint64_t total_allocations() noexcept {
+        lock_guard lock(*this);
+        return m_total_allocations;
+    }
+    std::uint64_t live_allocations() noexcept {
+        lock_guard lock(*this);
+        return m_live_allocations;
+    }
+
+    std::uint64_t max_allocated_size() noexcept {
+        lock_guard lock(*this);
+        return m_max_allocated_size;
+    }
+    std::uint64_t allocated_size() noexcept {
+        lock_guard lock(*this);
+        return m_allocated_size;
+    }
+
+    void set_error_countdown(std::uint64_t countdown) noexcept {
+        lock_guard lock(*this);
+        m_error_testing = true;
+        m_error_countdown = countdown;
+        // If countdown is zero, all the subsequent allocations will fail.
+        m_error_allocated_size = m_allocated_size;
+    }
+
+    std::uint64_t get_error_countdown() noexcept {
+        lock_guard lock(*this);
+        return m_error_countdown;
+    }
+
+    void pause_error_testing() noexcept {
+        lock_guard lock(*this);
+        m_error_testing = false;
+    }
+
+    void resume_error_testing() noexcept {
+        lock_guard lock(*this);
+        m_error_testing = true;
+    }
+
+    bool is_error_testing() noexcept {
+        lock_guard lock(*this);
+        return error_injection() && m_error_testing;
+    }
+
+    // The core allocation functions don't throw: they return false or nullptr on (simulated or real) failures and the
+    // public functions throw only at the API boundary.
+
+    bool error_point() noexcept {
+        operation_timer timer(profiled_operation::error_point);
+        lock_guard lock(*this);
+        return error_point_implementation(1);
+    }
+
+    void *allocate(std::size_t count, void const *site) noexcept {
+        operation_timer timer(profiled_operation::allocate);
+        if (inside_manager) {
+            return allocate_bootstrap(count, site);
+        }
+        delay_allocation(count);
+
+        lock_guard lock(*this);
+        if (!error_point_implementation(count)) {
+            return nullptr;
+        }
+        if (large_allocations_supported && count >= m_large_allocation_threshold) {
+            return allocate_large(count, site);
+        }
+        if (current_arena != nullptr) {
+            return allocate_arena(*current_arena, count, site);
+        }
+
+        void *allocation_ptr = malloc_allocate(sizeof(allocation_object) + count, std::nothrow);
+        if (allocation_ptr == nullptr) {
+            return nullptr;
+        }
+        void *user_ptr = register_allocation(allocation_ptr, count, 0, site);
+        if (user_ptr == nullptr) {
+            malloc_deallocate(allocation_ptr);
+        }
+        return user_ptr;
+    }
+
+    // Allocates using a memory block previously returned by release() and large enough for count bytes.
+    // The block is not taken over if the allocation fails.
+    void *allocate(std::size_t count, void *allocation_ptr, void const *site) noexcept {
+        delay_allocation(count);
+        lock_guard lock(*this);
+        if (!error_point_implementation(count)) {
+            return nullptr;
+        }
+        return register_allocation(allocation_ptr, count, 0, site);
+    }
+
+    // Allocates n blocks of count bytes under a single lock.
+    // Each allocation is an error point, in the order of the output pointers. If an allocation fails, the allocations
+    // already made by the batch are released and false is returned.
+    bool allocate_batch(std::size_t count, std::size_t n, void **ptrs, void const *site) noexcept {
+        if (inside_manager) {
+            return allocate_batch_bootstrap(count, n, ptrs, site);
+        }
+        delay_allocation(count);
+
+        lock_guard lock(*this);
+        if (large_allocations_supported && count >= m_large_allocation_threshold) {
+            return allocate_large_batch(count, n, ptrs, site);
+        }
+        if (tracking() && !m_pointers.reserve(m_pointers.size() + n)) {
+            return false;
+        }
+
+        auto category = current_thread_categories.current();
+        std::size_t allocated = 0;
+        for (; allocated != n; ++allocated) {
+            if (!error_point_implementation(count, static_cast<std::uint64_t>(count) * allocated)) {
+                break;
+            }
+            void *allocation_ptr = malloc_allocate(sizeof(allocation_object) + count, std::nothrow);
+            if (allocation_ptr == nullptr) {
+                break;
+            }
+            // The pointer table doesn't grow, it was reserved.
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            ptrs[allocated] = construct_allocation(allocation_ptr, count, category, 0, site);
+        }
+
+        if (allocated != n) {
+            for (std::size_t i = 0; i != allocated; ++i) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                void *ptr = ptrs[i];
+                if (tracking()) {
+                    m_pointers.erase(ptr);
+                }
+                auto allocation = allocation_object::from(ptr);
+                allocation->~allocation_object();
+                malloc_deallocate(allocation);
+            }
+            return false;
+        }
+        account_allocations(count, n, category);
+        return true;
+    }
+
+    // Deallocates n pointers under a single lock.
+    void deallocate_batch(void *const *ptrs, std::size_t n) noexcept {
+        if (inside_manager) {
+            for (std::size_t i = 0; i != n; ++i) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                deallocate(ptrs[i]);
+            }
+            return;
+        }
+
+        lock_guard lock(*this);
+        for (std::size_t i = 0; i != n; ++i) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            void *ptr = ptrs[i];
+            if (m_bootstrap_arena.contains(ptr)) {
+                deallocate_bootstrap(ptr);
+            } else {
+                malloc_deallocate(release_implementation(ptr));
+            }
+        }
+    }
+
+    // A deallocation that would have to wait for the lock is deferred: the allocation is pushed on a lock-free
+    // remote-free list that is drained by the next thread acquiring the lock.
+    void deallocate(void *ptr) noexcept {
+        if (ptr == nullptr) {
+            return;
+        }
+        operation_timer timer(profiled_operation::deallocate);
+        if (m_bootstrap_arena.contains(ptr)) {
+            deallocate_bootstrap(ptr);
+            return;
+        }
+        if (inside_manager) {
+            // Deallocation made while the manager is locked by the current thread.
+            push_remote_free(ptr);
+            return;
+        }
+
+        lock_guard lock(*this, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            if (push_remote_free(ptr)) {
+                return;
+            }
+            lock.lock();
+        }
+        malloc_deallocate(release_implementation(ptr));
+    }
+
+    // Deallocates a pointer without freeing its memory block.
+    // Returns the memory block (to be freed or reused by the caller) or nullptr if the pointer was not allocated by
+    // this allocator or it was a large allocation (whose memory is released by the manager).
+    void *release(void *ptr) noexcept {
+        lock_guard lock(*this);
+        return release_implementation(ptr);
+    }
+
+    remote_free_counters get_remote_free_counters() noexcept {
+        lock_guard lock(*this);
+        return remote_free_counters{m_remote_frees_count.load(std::memory_order_relaxed), m_remote_free_batches,
+                                    m_max_remote_free_batch};
+    }
+
+    // Arenas of the arena scopes.
+    // \{
+    arena *add_arena(std::size_t block_size) noexcept {
+        void *memory = malloc_allocate(sizeof(arena), std::nothrow);
+        if (memory == nullptr) {
+            return nullptr;
+        }
+        auto new_arena = new (memory) arena(block_size);
+        lock_guard lock(*this);
+        new_arena->next = m_arenas;
+        m_arenas = new_arena;
+        return new_arena;
+    }
+
+    // Releases an arena at the end of its scope.
+    // An arena with live allocations (including the ones whose deallocation is deferred) is detached instead: its
+    // region is released once they are deallocated.
+    void remove_arena(arena *removed_arena) noexcept {
+        arena_leftover_counters leftover{};
+        bool first_leftover = false;
+        {
+            lock_guard lock(*this);
+            removed_arena->for_each_allocation<allocation_object>([&](allocation_object *allocation) {
+                auto magic = allocation->magic.load(std::memory_order_relaxed);
+                if (magic == allocation_object::magic_value || magic == allocation_object::remote_free_magic_value) {
+                    ++leftover.allocations;
+                    leftover.allocated_size += allocation->count;
+                }
+            });
+            if (leftover.allocations != 0) {
+                removed_arena->detached = true;
+                removed_arena->detached_allocations = leftover.allocations;
+                ++m_detached_arenas;
+                first_leftover = m_arena_leftovers.scopes == 0;
+                ++m_arena_leftovers.scopes;
+                m_arena_leftovers.allocations += leftover.allocations;
+                m_arena_leftovers.allocated_size += leftover.allocated_size;
+                ++m_arena_leftovers.kept_regions;
+            } else {
+                unlink_arena(removed_arena);
+            }
+        }
+        if (first_leftover) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+            std::fprintf(stderr,
+                         "dev_new: live allocations at the end of an arena scope: %" PRIu64 " (%" PRIu64
+                         " bytes), its region is kept until they are deallocated (see arena_leftover_statistics())\n",
+                         leftover.allocations, leftover.allocated_size);
+        }
+        if (leftover.allocations == 0) {
+            free_arena(removed_arena);
+        }
+    }
+
+    arena_leftover_counters get_arena_leftover_counters() noexcept {
+        lock_guard lock(*this);
+        return m_arena_leftovers;
+    }
+
+    arena_counters get_arena_counters(arena const &counted_arena) noexcept {
+        lock_guard lock(*this);
+        return counted_arena.counters();
+    }
+    // \}
+
+    overhead_counters get_overhead_counters() noexcept {
+        lock_guard lock(*this);
+        overhead_counters counters{m_allocated_size, m_live_allocations * sizeof(allocation_object), sizeof(*this),
+                                   0, 0, 0};
+        counters.metadata_size +=
+            (m_pointers.capacity() + m_large_allocations.capacity() + m_arena_allocations.capacity()) * sizeof(void *);
+        for (auto table = category_tables.load(std::memory_order_acquire); table != nullptr; table = table->next) {
+            counters.metadata_size += sizeof(category_table);
+        }
+
+        auto live_size = [](allocation_object const &allocation) {
+            return static_cast<std::uint64_t>(sizeof(allocation_object) + allocation.count);
+        };
+#if BOOST_OS_LINUX
+        // Large and arena allocations are not in the pointer table.
+        m_pointers.for_each([&](void *ptr) {
+            auto allocation = allocation_object::from(ptr);
+            counters.slack_size += malloc_usable_size(allocation) - live_size(*allocation);
+        });
+#endif
+        // The rest of the last page of the live large allocations and the cached mappings (without the large
+        // allocations table, which is only filled with tracking).
+        counters.slack_size += m_large_counters.mapped_size - m_large_live_size;
+        for (auto counted_arena = m_arenas; counted_arena != nullptr; counted_arena = counted_arena->next) {
+            counters.metadata_size += counted_arena->metadata_size();
+            counters.slack_size += counted_arena->counters().reserved_size;
+            counted_arena->for_each_allocation<allocation_object>([&](allocation_object *allocation) {
+                if (allocation->magic.load(std::memory_order_relaxed) == allocation_object::magic_value) {
+                    counters.slack_size -= live_size(*allocation);
+                }
+            });
+        }
+        read_process_memory(counters);
+        return counters;
+    }
+
+    lock_counters get_lock_counters() noexcept {
+        lock_guard lock(*this);
+        return m_lock_counters;
+    }
+
+    bool check_allocation(void *ptr) noexcept {
+        operation_timer timer(profiled_operation::check_allocation);
+        lock_guard lock(*this);
+        return contains(ptr);
+    }
+
+    void set_self_profiling(bool enabled) noexcept {
+        lock_guard lock(*this);
+        if (enabled && !self_profiling.load(std::memory_order_relaxed)) {
+            profile_data.start_ticks.store(now_ticks(), std::memory_order_relaxed);
+            profile_data.start_nanoseconds.store(now_nanoseconds(), std::memory_order_relaxed);
+        }
+        m_pointers.count_probes(enabled);
+        self_profiling.store(enabled, std::memory_order_relaxed);
+    }
+
+    std::array<std::uint64_t, probe_length_buckets> get_probe_lengths() noexcept {
+        lock_guard lock(*this);
+        return m_pointers.probe_lengths();
+    }
+
+    void const *get_allocation_site(void *ptr) noexcept {
+        lock_guard lock(*this);
+        if (!contains(ptr)) {
+            return nullptr;
+        }
+        return allocation_object::from(ptr)->site();
+    }
+
+    void set_large_allocation_threshold(std::size_t threshold) noexcept {
+        lock_guard lock(*this);
+        m_large_allocation_threshold = threshold;
+    }
+
+    std::size_t get_large_allocation_threshold() noexcept {
+        lock_guard lock(*this);
+        return m_large_allocation_threshold;
+    }
+
+    large_allocation_counters get_large_allocation_counters() noexcept {
+        lock_guard lock(*this);
+        return m_large_counters;
+    }
+
+    // Live and maximum allocated size of a category.
+    struct category_size {
+        std::uint64_t allocated_size;
+        std::uint64_t max_allocated_size;
+    };
+
+    category_size get_category_size(std::uint16_t category) noexcept {
+        lock_guard lock(*this);
+        return m_category_sizes.at(category);
+    }
+
+    std::uint32_t add_operation() noexcept {
+        lock_guard lock(*this);
+        return m_operations.add();
+    }
+
+    operation_statistics remove_operation(std::uint32_t id) noexcept {
+        lock_guard lock(*this);
+        return m_operations.remove(id);
+    }
+
+    operation_statistics get_operation_statistics(std::uint32_t id) noexcept {
+        lock_guard lock(*this);
+        auto operation = m_operations.find(id);
+        return operation != nullptr ? *operation : operation_statistics{};
+    }
+
+    lifetime_statistics get_size_class_lifetimes(std::size_t size_class) noexcept {
+        lock_guard lock(*this);
+        return m_lifetimes.size_class(size_class);
+    }
+
+    std::size_t get_lifetime_site_count() noexcept {
+        lock_guard lock(*this);
+        return m_lifetimes.site_count();
+    }
+
+    std::size_t copy_site_lifetimes(site_lifetime_statistics *sites, std::size_t max_count) noexcept {
+        lock_guard lock(*this);
+        return m_lifetimes.copy_sites(sites, max_count);
+    }
+
+    // Copies the counters of a statistics segment snapshot (see publish_statistics()), the sizes of the categories and
+    // the sites with the most deallocations (see lifetime_table::copy_top_sites()) in a single lock acquisition, so
+    // that they are consistent with one another.
+    // Returns the number of copied sites.
+    std::size_t copy_published_statistics(stats_segment::snapshot &data,
+                                          std::array<category_size, max_categories> &category_sizes,
+                                          site_lifetime_statistics *sites, std::size_t max_count) noexcept {
+        lock_guard lock(*this);
+        data.total_allocations = m_total_allocations;
+        data.live_allocations = m_live_allocations;
+        data.allocated_size = m_allocated_size;
+        data.max_allocated_size = m_max_allocated_size;
+        data.lock_acquisitions = m_lock_counters.acquisitions;
+        data.contended_lock_acquisitions = m_lock_counters.contended_acquisitions;
+        data.lock_wait_nanoseconds = m_lock_counters.wait_nanoseconds;
+        data.remote_frees = m_remote_frees_count.load(std::memory_order_relaxed);
+        data.large_live_allocations = m_large_counters.live_allocations;
+        data.large_mapped_size = m_large_counters.mapped_size;
+        category_sizes = m_category_sizes;
+        return m_lifetimes.copy_top_sites(sites, max_count);
+    }
+
+    // Copies the live tracked allocations (see snapshot()) except the buffer they are copied to, which is expected to
+    // be an allocation.
+    // Returns the number of allocations to copy: nothing is copied if it exceeds max_count.
+    std::size_t copy_live_allocations(snapshot_allocation *allocations, std::size_t max_count) noexcept {
+        lock_guard lock(*this);
+        if (!tracking()) {
+            return 0;
+        }
+        auto count = m_pointers.size() + m_large_allocations.size() + m_arena_allocations.size();
+        if (m_pointers.contains(allocations) || m_large_allocations.contains(allocations) ||
+            m_arena_allocations.contains(allocations)) {
+            --count;
+        }
+        if (count > max_count) {
+            return count;
+        }
+        std::size_t copied = 0;
+        auto copy = [&](void *ptr) {
+            if (ptr == allocations) {
+                return;
+            }
+            auto allocation = allocation_object::from(ptr);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            allocations[copied++] =
+                snapshot_allocation{ptr, allocation->count, allocation->site(), allocation->category};
+        };
+        m_pointers.for_each(copy);
+        m_large_allocations.for_each(copy);
+        m_arena_allocations.for_each(copy);
+        return copied;
+    }
+
+#if BOOST_OS_LINUX
+    // Runs a reachability scan of the live allocations (see find_leaks()).
+    // The lock is held while scanning, so that the scanned allocations stay alive.
+    // Returns false if the scanner could not allocate its buffers.
+    bool scan_leaks(leak_scanner &scanner, unsigned thread_count) noexcept {
+        lock_guard lock(*this);
+        if (!tracking() || !scanner.check_other_threads()) {
+            return true;
+        }
+        if (!scanner.reserve(m_pointers.size() + m_large_allocations.size())) {
+            return false;
+        }
+        auto add = [&](void *ptr) {
+            auto allocation = allocation_object::from(ptr);
+            scanner.add(ptr, allocation->count, allocation->site());
+        };
+        m_pointers.for_each(add);
+        m_large_allocations.for_each(add);
+        if (!scanner.prepare()) {
+            return false;
+        }
+        for (auto root_arena = m_arenas; root_arena != nullptr; root_arena = root_arena->next) {
+            root_arena->for_each_allocation<allocation_object>([&](allocation_object *allocation) {
+                if (allocation->magic.load(std::memory_order_relaxed) == allocation_object::magic_value) {
+                    scanner.scan_root(&allocation->ptr, allocation->count);
+                }
+            });
+        }
+        scanner.scan_roots();
+        return scanner.mark(thread_count) && scanner.collect_leaks();
+    }
+#endif
+
+    // Sets the runtime features (before any allocation).
+    void configure(bool tracking, bool error_injection) noexcept {
+        lock_guard lock(*this);
+        DEV_NEW_ASSERT(m_total_allocations == 0 || (m_tracking == tracking));
+        m_tracking = tracking;
+        m_error_injection = error_injection;
+    }
+
+  private:
+    friend union memory_manager_storage;
+
+    constexpr basic_memory_manager() noexcept
+        : m_total_allocations{}, m_live_allocations{}, m_allocated_size{}, m_max_allocated_size{}, m_next_peak_event{},
+          m_category_sizes{}, m_lock_counters{}, m_remote_frees{},
+          m_remote_frees_count{}, m_remote_free_batches{}, m_max_remote_free_batch{}, m_large_cache{},
+          m_large_allocation_threshold{default_large_allocation_threshold}, m_large_counters{}, m_large_live_size{},
+          m_arenas{}, m_arena_allocations{}, m_detached_arenas{}, m_arena_leftovers{}, m_bootstrap_allocations{},
+          m_tracking{true}, m_error_injection{true}, m_error_testing{},
+          m_error_countdown{UINT64_MAX}, m_error_allocated_size{UINT64_MAX} {}
+
+    ~basic_memory_manager() = default;
+
+    // Lock of the manager.
+    // While it is held, the current thread is marked as running inside the manager. Once it is acquired, the
+    // deallocations deferred while the manager was locked are completed.
+    class lock_guard {
+      public:
+        explicit lock_guard(basic_memory_manager &manager) noexcept : m_manager{manager}, m_owns{} { lock(); }
+        lock_guard(basic_memory_manager &manager, std::try_to_lock_t /*unused*/) noexcept
+            : m_manager{manager}, m_owns{manager.m_mutex.try_lock()} {
+            if (m_owns) {
+                on_locked(0);
+            }
+        }
+        ~lock_guard() {
+            if (m_owns) {
+                inside_manager = false;
+                m_manager.m_mutex.unlock();
+            }
+        }
+
+        lock_guard(lock_guard const & /*unused*/) = delete;
+        lock_guard(lock_guard && /*unused*/) = delete;
+        lock_guard &operator=(lock_guard const & /*unused*/) = delete;
+        lock_guard &operator=(lock_guard && /*unused*/) = delete;
+
+        void lock() noexcept {
+            std::uint64_t wait_nanoseconds = 0;
+            if (!m_manager.m_mutex.try_lock()) {
+                auto start = now_nanoseconds();
+                m_manager.m_mutex.lock();
+                // A contended acquisition takes at least one nanosecond.
+                wait_nanoseconds = std::max<std::uint64_t>(now_nanoseconds() - start, 1);
+                if (self_profiling.load(std::memory_order_relaxed)) {
+                    profile_data.lock_wait_nanoseconds.record(wait_nanoseconds);
+                }
+            }
+            m_owns = true;
+            on_locked(wait_nanoseconds);
+        }
+
+        bool owns_lock() const noexcept { return m_owns; }
+
+      private:
+        void on_locked(std::uint64_t wait_nanoseconds) noexcept {
+            inside_manager = true;
+            auto &counters = m_manager.m_lock_counters;
+            ++counters.acquisitions;
+            if (wait_nanoseconds != 0) {
+                ++counters.contended_acquisitions;
+                counters.wait_nanoseconds += wait_nanoseconds;
+            }
+            m_manager.drain_remote_frees();
+        }
+
+        basic_memory_manager &m_manager;
+        bool m_owns;
+    };
+
+    // Features enabled at compile time and by the runtime mode.
+    // \{
+    bool tracking() const noexcept { return Features::tracking && m_tracking; }
+    bool error_injection() const noexcept { return Features::error_injection && m_error_injection; }
+    // \}
+
+    // Checks if a pointer is a live allocation (the lock must be held).
+    // Without tracking, only the allocation header of the pointer is checked.
+    bool contains(void *ptr) const noexcept {
+        if (tracking() && !m_bootstrap_arena.contains(ptr)) {
+            return m_pointers.contains(ptr) || m_large_allocations.contains(ptr) || m_arena_allocations.contains(ptr);
+        }
+        if (ptr == nullptr) {
+            return false;
+        }
+        auto allocation = allocation_object::from(ptr);
+        return allocation->magic.load(std::memory_order_relaxed) == allocation_object::magic_value;
+    }
+
+    // Allocates in the bootstrap arena (the current thread is inside the manager, so it holds the lock).
+    // Bootstrap allocations are not error points.
+    void *allocate_bootstrap(std::size_t count, void const *site) noexcept {
+        void *allocation_ptr = m_bootstrap_arena.allocate(sizeof(allocation_object) + count);
+        if (allocation_ptr == nullptr) {
+            return nullptr;
+        }
+        ++m_bootstrap_allocations;
+        return register_allocation(allocation_ptr, count, allocation_object::bootstrap_flag, site);
+    }
+
+    // Allocates in the region of an arena (the lock must be held).
+    void *allocate_arena(arena &allocation_arena, std::size_t count, void const *site) noexcept {
+        void *allocation_ptr = allocation_arena.allocate(sizeof(allocation_object) + count);
+        if (allocation_ptr == nullptr) {
+            return nullptr;
+        }
+        void *user_ptr = register_allocation(allocation_ptr, count, allocation_object::arena_flag, site);
+        if (user_ptr != nullptr) {
+            allocation_arena.account(count);
+        }
+        return user_ptr;
+    }
+
+    // Deallocates an arena allocation (the lock must be held): its memory is released with the arena.
+    void deallocate_arena(allocation_object *allocation) noexcept {
+        DEV_NEW_ASSERT_MSG(allocation->magic.load(std::memory_order_relaxed) == allocation_object::magic_value,
+                           "pointer deallocated twice");
+        account_deallocation(*allocation);
+        release_arena_allocation(allocation);
+    }
+
+    // Unregisters an arena allocation (the lock must be held).
+    // The region of a detached arena is released with its last allocation.
+    void release_arena_allocation(allocation_object *allocation) noexcept {
+        unregister_allocation(allocation);
+        if (m_detached_arenas == 0) {
+            return;
+        }
+        for (auto a = m_arenas; a != nullptr; a = a->next) {
+            if (a->detached && a->contains(allocation)) {
+                DEV_NEW_ASSERT(a->detached_allocations != 0);
+                if (--a->detached_allocations == 0) {
+                    --m_detached_arenas;
+                    --m_arena_leftovers.kept_regions;
+                    unlink_arena(a);
+                    free_arena(a);
+                }
+                return;
+            }
+        }
+    }
+
+    // Removes an arena from the list of arenas (the lock must be held).
+    void unlink_arena(arena *removed_arena) noexcept {
+        auto next = &m_arenas;
+        while (*next != removed_arena) {
+            next = &(*next)->next;
+        }
+        *next = removed_arena->next;
+    }
+
+    static void free_arena(arena *removed_arena) noexcept {
+        removed_arena->~arena();
+        malloc_deallocate(removed_arena);
+    }
+
+    void deallocate_bootstrap(void *ptr) noexcept {
+        auto allocation = allocation_object::from(ptr);
+        auto release = [&] {
+            DEV_NEW_ASSERT(m_bootstrap_allocations != 0);
+            --m_bootstrap_allocations;
+            account_deallocation(*allocation);
+            unregister_allocation(allocation);
+        };
+        if (inside_manager) {
+            release();
+        } else {
+            lock_guard lock(*this);
+            release();
+        }
+    }
+
+    // Batch allocations made one by one, rolling back the batch on failure (the lock must be held).
+    // \{
+    bool allocate_batch_bootstrap(std::size_t count, std::size_t n, void **ptrs, void const *site) noexcept {
+        for (std::size_t i = 0; i != n; ++i) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            ptrs[i] = allocate_bootstrap(count, site);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (ptrs[i] == nullptr) {
+                for (std::size_t j = 0; j != i; ++j) {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    deallocate_bootstrap(ptrs[j]);
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool allocate_large_batch(std::size_t count, std::size_t n, void **ptrs, void const *site) noexcept {
+        for (std::size_t i = 0; i != n; ++i) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            ptrs[i] = error_point_implementation(count) ? allocate_large(count, site) : nullptr;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (ptrs[i] == nullptr) {
+                for (std::size_t j = 0; j != i; ++j) {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    release_large(ptrs[j], true);
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+    // \}
+
+    // Registers a new allocation in the given memory block (the lock must be held).
+    // Only the allocations without flags are added to the pointer table and the arena allocations to the arena
+    // allocations table, large allocations are expected to be already added to the large allocations table.
+    // Returns nullptr if the pointer table could not grow.
+    void *register_allocation(void *allocation_ptr, std::size_t count, std::uint16_t flags,
+                              void const *site) noexcept {
+        auto category = Features::statistics ? current_thread_categories.current() : no_category;
+        void *user_ptr = construct_allocation(allocation_ptr, count, category, flags, site);
+        if (user_ptr != nullptr) {
+            account_allocations(count, 1, category);
+        }
+        return user_ptr;
+    }
+
+    // Constructs the allocation object and adds the allocation without flags or the arena allocation to its pointer
+    // table (the lock must be held). The allocation is not accounted.
+    // Returns nullptr if the pointer table could not grow.
+    void *construct_allocation(void *allocation_ptr, std::size_t count, std::uint16_t category, std::uint16_t flags,
+                               void const *site) noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+        auto operation = Features::statistics ? current_operation : 0;
+        auto allocation = new (allocation_ptr)
+            allocation_object(count, category, flags, Features::stack_capture ? site : nullptr, operation);
+        void *user_ptr = &allocation->ptr;
+        if (tracking() && ((flags == 0 && !m_pointers.insert(user_ptr)) ||
+                           (flags == allocation_object::arena_flag && !m_arena_allocations.insert(user_ptr)))) {
+            allocation->~allocation_object();
+            return nullptr;
+        }
+        if constexpr (Features::fill_patterns) {
+            std::memset(user_ptr, allocation_object::allocated_fill, count);
+        }
+        if constexpr (Features::lifetimes) {
+            allocation->birth_time() = now_nanoseconds();
+            // The clock once the allocation is accounted: the lifetime in ticks is the number of allocations made
+            // while it is alive.
+            allocation->birth_tick() = m_total_allocations + 1;
+        }
+        if constexpr (Features::stack_capture) {
+            record_growth_event(site, count, true);
+        }
+        publish_event(allocation_event_type::allocate, user_ptr, count, allocation->site());
+        return user_ptr;
+    }
+
+    // Accounts n constructed allocations of count bytes (the lock must be held).
+    void account_allocations(std::size_t count, std::size_t n, std::uint16_t category) noexcept {
+        auto size = static_cast<std::uint64_t>(count) * n;
+        m_total_allocations += n;
+        m_live_allocations += n;
+        m_allocated_size += size;
+        if (m_allocated_size > m_max_allocated_size) {
+            m_max_allocated_size = m_allocated_size;
+            if (m_max_allocated_size >= m_next_peak_event) {
+                m_next_peak_event = m_max_allocated_size + m_max_allocated_size / 16 + 1;
+                publish_event(allocation_event_type::peak_reached, nullptr, m_max_allocated_size, nullptr);
+            }
+        }
+        if constexpr (!Features::statistics) {
+            return;
+        }
+
+        auto &category_size = m_category_sizes.at(category);
+        category_size.allocated_size += size;
+        category_size.max_allocated_size = std::max(category_size.max_allocated_size, category_size.allocated_size);
+        auto &category_counters = current_thread_categories.counters(category);
+        category_counters.total_allocations.fetch_add(n, std::memory_order_relaxed);
+        category_counters.total_allocated_size.fetch_add(size, std::memory_order_relaxed);
+
+        thread_counters.allocations += n;
+        thread_counters.allocated_size += size;
+        thread_counters.max_allocation_size = std::max<std::uint64_t>(thread_counters.max_allocation_size, count);
+
+        if (auto operation = m_operations.find(current_operation)) {
+            operation->total_allocations += n;
+            operation->total_allocated_size += size;
+            operation->allocated_size += size;
+            operation->max_allocated_size = std::max(operation->max_allocated_size, operation->allocated_size);
+        }
+    }
+
+    // Large allocation mapped directly from the system (the allocation object is at the start of the mapping).
+    struct large_block {
+        void *ptr;
+        std::size_t size;
+    };
+    using large_block_cache = std::array<large_block, 4>;
+    static std::size_t const max_cached_large_block_size = 64U << 20U;
+
+    static std::size_t large_block_size(std::size_t count) noexcept {
+        auto pages = page_size();
+        return (sizeof(allocation_object) + count + pages - 1) / pages * pages;
+    }
+
+    void *allocate_large(std::size_t count, void const *site) noexcept {
+        auto size = large_block_size(count);
+        auto block = take_cached_large_block(size);
+        if (block.ptr == nullptr) {
+            block = large_block{map_pages(size), size};
+            if (block.ptr == nullptr) {
+                return nullptr;
+            }
+            ++m_large_counters.mappings;
+            m_large_counters.mapped_size += size;
+        }
+
+        void *user_ptr = &static_cast<allocation_object *>(block.ptr)->ptr;
+        if (tracking() && !m_large_allocations.insert(user_ptr)) {
+            recycle_large_block(block);
+            return nullptr;
+        }
+        ++m_large_counters.live_allocations;
+        m_large_live_size += sizeof(allocation_object) + count;
+        return register_allocation(block.ptr, count, allocation_object::large_flag, site);
+    }
+
+    // Releases a large allocation (the lock must be held).
+    // Returns false if the pointer isn't a large allocation (only checked with tracking).
+    bool release_large(void *ptr, bool account) noexcept {
+        if (tracking() && !m_large_allocations.erase(ptr)) {
+            return false;
+        }
+        --m_large_counters.live_allocations;
+
+        auto allocation = allocation_object::from(ptr);
+        m_large_live_size -= sizeof(allocation_object) + allocation->count;
+        if (account) {
+            account_deallocation(*allocation);
+        }
+        large_block block{allocation, large_block_size(allocation->count)};
+        unregister_allocation(allocation);
+        recycle_large_block(block);
+        return true;
+    }
+
+    // Keeps the mapping of a released large allocation in the cache (without its pages) or unmaps it.
+    void recycle_large_block(large_block block) noexcept {
+        if (block.size <= max_cached_large_block_size) {
+            for (auto &cached : m_large_cache) {
+                if (cached.ptr == nullptr) {
+                    discard_pages(block.ptr, block.size);
+                    cached = block;
+                    ++m_large_counters.cached_mappings;
+                    return;
+                }
+            }
+        }
+        unmap_pages(block.ptr, block.size);
+        m_large_counters.mapped_size -= block.size;
+    }
+
+    // Takes a cached mapping of at least the given size (and not more than twice the size), unmapping its extra pages.
+    large_block take_cached_large_block(std::size_t size) noexcept {
+        for (auto &cached : m_large_cache) {
+            if (cached.ptr != nullptr && cached.size >= size && cached.size / 2 <= size) {
+                auto block = cached;
+                cached = large_block{};
+                if (block.size != size) {
+                    unmap_pages(static_cast<char *>(block.ptr) + size, block.size - size);
+                    m_large_counters.mapped_size -= block.size - size;
+                    block.size = size;
+                }
+                --m_large_counters.cached_mappings;
+                ++m_large_counters.reused_mappings;
+                return block;
+            }
+        }
+        return large_block{};
+    }
+
+    // Releases an allocation (the lock must be held).
+    void *release_implementation(void *ptr) noexcept {
+        if (ptr == nullptr) {
+            return nullptr;
+        }
+        auto user_ptr = static_cast<std::size_t *>(ptr);
+        auto allocation = allocation_object::from(user_ptr);
+        if (tracking()) {
+            if (!m_pointers.erase(ptr)) {
+                if (m_arena_allocations.erase(ptr)) {
+                    deallocate_arena(allocation);
+                } else {
+                    release_large(ptr, true);
+                }
+                return nullptr;
+            }
+        } else {
+            DEV_NEW_ASSERT_MSG(allocation->magic.load(std::memory_order_relaxed) == allocation_object::magic_value,
+                               "pointer not allocated by this allocator");
+            if ((allocation->flags & allocation_object::large_flag) != 0) {
+                release_large(ptr, true);
+                return nullptr;
+            }
+            if ((allocation->flags & allocation_object::arena_flag) != 0) {
+                deallocate_arena(allocation);
+                return nullptr;
+            }
+        }
+
+        account_deallocation(*allocation);
+        return unregister_allocation(allocation);
+    }
+
+    // Deallocation accounting made by the deallocating thread.
+    static void account_deallocation(allocation_object const &allocation) noexcept {
+        if constexpr (Features::stack_capture) {
+            record_growth_event(allocation.site(), allocation.count, false);
+        }
+        if constexpr (!Features::statistics) {
+            return;
+        }
+        ++thread_counters.deallocations;
+        thread_counters.deallocated_size += allocation.count;
+        current_thread_categories.counters(allocation.category)
+            .total_deallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Unregisters an allocation already removed from the pointer set (the lock must be held).
+    // Returns its memory block.
+    void *unregister_allocation(allocation_object *allocation) noexcept {
+        DEV_NEW_ASSERT(allocation->count <= m_allocated_size);
+        DEV_NEW_ASSERT(m_live_allocations != 0);
+        --m_live_allocations;
+        m_allocated_size -= allocation->count;
+        if (Features::statistics) {
+            m_category_sizes.at(allocation->category).allocated_size -= allocation->count;
+            if (auto operation = m_operations.find(allocation->operation())) {
+                operation->allocated_size -= allocation->count;
+            }
+        }
+        if constexpr (Features::fill_patterns) {
+            std::memset(&allocation->ptr, allocation_object::freed_fill, allocation->count);
+        }
+        if constexpr (Features::lifetimes) {
+            m_lifetimes.record(allocation->site(), allocation->count, now_nanoseconds() - allocation->birth_time(),
+                               m_total_allocations - allocation->birth_tick());
+        }
+        publish_event(allocation_event_type::deallocate, &allocation->ptr, allocation->count, allocation->site());
+        void *allocation_ptr = allocation;
+        allocation->~allocation_object();
+        return allocation_ptr;
+    }
+
+    // Pushes an allocation on the remote-free list.
+    // Only the pointers with a valid allocation header are deferred: the header is read before it is written and the
+    // pointer is checked against the tables when the list is drained.
+    // Returns false if the pointer doesn't have a valid header, in which case the deallocation has to be made under
+    // lock.
+    bool push_remote_free(void *ptr) noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (reinterpret_cast<std::uintptr_t>(ptr) % alignof(std::max_align_t) != 0) {
+            return false;
+        }
+        auto user_ptr = static_cast<std::size_t *>(ptr);
+        auto allocation = allocation_object::from(user_ptr);
+        auto magic = allocation->magic.load(std::memory_order_relaxed);
+        if (magic != allocation_object::magic_value ||
+            !allocation->magic.compare_exchange_strong(magic, allocation_object::remote_free_magic_value,
+                                                       std::memory_order_relaxed)) {
+            DEV_NEW_ASSERT_MSG(magic != allocation_object::remote_free_magic_value, "pointer deallocated twice");
+            return false;
+        }
+
+        account_deallocation(*allocation);
+        auto next = m_remote_frees.load(std::memory_order_relaxed);
+        do {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            allocation->ptr = reinterpret_cast<std::size_t>(next);
+        } while (!m_remote_frees.compare_exchange_weak(next, allocation, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+        m_remote_frees_count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Completes the deferred deallocations (the lock must be held).
+    void drain_remote_frees() noexcept {
+        auto allocation = m_remote_frees.exchange(nullptr, std::memory_order_acquire);
+        if (allocation == nullptr) {
+            return;
+        }
+
+        std::uint64_t batch_size = 0;
+        while (allocation != nullptr) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            auto next = reinterpret_cast<allocation_object *>(allocation->ptr);
+            allocation->magic.store(allocation_object::magic_value, std::memory_order_relaxed);
+            // With tracking, the pointers are checked against the tables as in the locked path: a pointer whose header
+            // only looked valid is ignored.
+            if ((allocation->flags & allocation_object::large_flag) != 0) {
+                release_large(&allocation->ptr, false);
+            } else if ((allocation->flags & allocation_object::arena_flag) != 0) {
+                if (!tracking() || m_arena_allocations.erase(&allocation->ptr)) {
+                    release_arena_allocation(allocation);
+                }
+            } else if (!tracking() || m_pointers.erase(&allocation->ptr)) {
+                malloc_deallocate(unregister_allocation(allocation));
+            }
+            allocation = next;
+            ++batch_size;
+        }
+        ++m_remote_free_batches;
+        m_max_remote_free_batch = std::max(m_max_remote_free_batch, batch_size);
+    }
+
+    // Returns false if the error point raises a (simulated) out-of-memory error.
+    // The pending size is the size of the allocations already made but not yet accounted (in a batch).
+    bool error_point_implementation(std::size_t count, std::uint64_t pending_size = 0) noexcept {
+        if (error_injection() && m_error_testing) {
+            if (m_error_countdown > 1) {
+                --m_error_countdown;
+            } else if (m_error_countdown == 1) {
+                m_error_allocated_size = m_allocated_size + pending_size;
+                m_error_countdown = 0;
+                publish_event(allocation_event_type::error_injected, nullptr, count, nullptr);
+                return false;
+            } else if (m_allocated_size + pending_size + count > m_error_allocated_size) {
+                publish_event(allocation_event_type::error_injected, nullptr, count, nullptr);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    mutable std::mutex m_mutex;
+    pointer_table m_pointers;
+    std::uint64_t m_total_allocations;
+    std::uint64_t m_live_allocations;
+    std::uint64_t m_allocated_size;
+    std::uint64_t m_max_allocated_size;
+    // The max allocated size that publishes the next peak_reached event.
+    std::uint64_t m_next_peak_event;
+    std::array<category_size, max_categories> m_category_sizes;
+    lock_counters m_lock_counters;
+
+    std::atomic<allocation_object *> m_remote_frees;
+    std::atomic<std::uint64_t> m_remote_frees_count;
+    std::uint64_t m_remote_free_batches;
+    std::uint64_t m_max_remote_free_batch;
+
+    pointer_table m_large_allocations;
+    large_block_cache m_large_cache;
+    std::size_t m_large_allocation_threshold;
+    large_allocation_counters m_large_counters;
+    // Size of the live large allocations with their allocation objects (the rest of their mappings is slack).
+    std::uint64_t m_large_live_size;
+
+    bootstrap_arena m_bootstrap_arena;
+    std::conditional_t<Features::lifetimes, lifetime_table, no_lifetime_table> m_lifetimes;
+    operation_table m_operations;
+    // Arenas of the arena scopes and the allocations made in their regions (with tracking).
+    arena *m_arenas;
+    pointer_table m_arena_allocations;
+    std::size_t m_detached_arenas;
+    arena_leftover_counters m_arena_leftovers;
+    std::uint64_t m_bootstrap_allocations;
+
+    // Runtime features (see runtime_mode).
+    bool m_tracking;
+    bool m_error_injection;
+
+    bool m_error_testing;
+    std::uint64_t m_error_countdown;
+    std::uint64_t m_error_allocated_size;
+};
+
+using memory_manager = basic_memory_manager<configured_features>;
+
+// Storage of the memory manager: constant-initialized and never destroyed.
+union memory_manager_storage {
+    constexpr memory_manager_storage() noexcept : manager{} {}
+    // The manager is not destroyed.
+    // NOLINTNEXTLINE(modernize-use-equals-default)
+    ~memory_manager_storage() {}
+
+    memory_manager_storage(memory_manager_storage const & /*unused*/) = delete;
+    memory_manager_storage(memory_manager_storage && /*unused*/) = delete;
+    memory_manager_storage &operator=(memory_manager_storage const & /*unused*/) = delete;
+    memory_manager_storage &operator=(memory_manager_storage && /*unused*/) = delete;
+
+    memory_manager manager;
+};
+
+#if BOOST_COMP_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+[[clang::require_constant_initialization]]
+#endif
+memory_manager_storage manager_storage;
+#if BOOST_COMP_CLANG
+#pragma clang diagnostic pop
+#endif
+
+// Runtime options read from the DEV_NEW_OPTIONS environment variable.
+// The options are parsed once, by the first call that needs them (i.e. before the first allocation), without
+// allocating memory.
+// \{
+int const runtime_mode_unset = -1;
+std::atomic<int> current_runtime_mode{runtime_mode_unset};
+std::once_flag runtime_options_once;
+
+// Checks if an option (a token of the options string) starts with a prefix.
+bool option_starts_with(char const *option, std::size_t length, char const *prefix) noexcept {
+    auto prefix_length = std::strlen(prefix);
+    return length >= prefix_length && std::strncmp(option, prefix, prefix_length) == 0;
+}
+
+bool option_equals(char const *option, std::size_t length, char const *value) noexcept {
+    return length == std::strlen(value) && std::strncmp(option, value, length) == 0;
+}
+
+// Parses an option made of a prefix followed by a decimal number.
+// Returns false if the option doesn't start with the prefix or if the rest of the option is not a number.
+bool parse_numeric_option(char const *option, std::size_t length, char const *prefix, std::uint64_t &value) noexcept {
+    if (!option_starts_with(option, length, prefix)) {
+        return false;
+    }
+    auto prefix_length = std::strlen(prefix);
+    if (length == prefix_length) {
+        return false;
+    }
+    std::uint64_t number = 0;
+    for (auto i = prefix_length; i != length; ++i) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto c = option[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        auto digit = static_cast<std::uint64_t>(c - '0');
+        if (number > (std::numeric_limits<std::uint64_t>::max() - digit) / 10) {
+            return false;
+        }
+        number = number * 10 + digit;
+    }
+    value = number;
+    return true;
+}
+
+void parse_runtime_option(char const *option, std::size_t length, runtime_mode &mode,
+                          std::uint64_t &error_countdown) noexcept {
+    char const mode_prefix[] = "mode=";
+    if (option_starts_with(option, length, mode_prefix)) {
+        option += sizeof(mode_prefix) - 1;
+        length -= sizeof(mode_prefix) - 1;
+    }
+
+    std::uint64_t value = 0;
+    if (option_equals(option, length, "passthrough")) {
+        mode = runtime_mode::passthrough;
+    } else if (option_equals(option, length, "stats")) {
+        mode = runtime_mode::stats;
+    } else if (option_equals(option, length, "full")) {
+        mode = runtime_mode::full;
+    } else if (option_equals(option, length, "error_testing")) {
+        mode = runtime_mode::error_testing;
+    } else if (parse_numeric_option(option, length, "large_threshold=", value)) {
+        manager_storage.manager.set_large_allocation_threshold(static_cast<std::size_t>(value));
+    } else if (option_equals(option, length, "self_profile")) {
+        manager_storage.manager.set_self_profiling(true);
+        std::atexit([] { print_self_profile(stderr); });
+    } else if (parse_numeric_option(option, length, "delay=", value)) {
+        latency_injection_policy policy{};
+        policy.max_delay_nanoseconds = value;
+        set_latency_injection(policy);
+    } else if (parse_numeric_option(option, length, "error_countdown=", value)) {
+        // Set once the mode is known.
+        error_countdown = value;
+    } else {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(stderr, "dev_new: invalid option in DEV_NEW_OPTIONS: %.*s\n", static_cast<int>(length), option);
+    }
+}
+
+void parse_runtime_options() noexcept {
+    auto mode = runtime_mode::error_testing;
+    auto error_countdown = std::numeric_limits<std::uint64_t>::max();
+    if (char const *options = std::getenv("DEV_NEW_OPTIONS")) {
+        while (*options != '\0') {
+            auto length = std::strcspn(options, ", ");
+            if (length != 0) {
+                parse_runtime_option(options, length, mode, error_countdown);
+            }
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            options += length;
+            if (*options != '\0') {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                ++options;
+            }
+        }
+    }
+
+    if (error_countdown != std::numeric_limits<std::uint64_t>::max()) {
+        if (mode == runtime_mode::error_testing) {
+            manager_storage.manager.set_error_countdown(error_countdown);
+        } else {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+            std::fprintf(stderr, "dev_new: error_countdown in DEV_NEW_OPTIONS ignored: error testing is disabled in "
+                                 "this mode\n");
+        }
+    }
+
+    // In passthrough mode, the manager only serves the dev_new::allocate() calls (their pointers stay tracked, so that
+    // the pointers allocated by malloc are not mistaken for allocations).
+    manager_storage.manager.configure(mode != runtime_mode::stats, mode == runtime_mode::error_testing);
+    current_runtime_mode.store(static_cast<int>(mode), std::memory_order_release);
+}
+
+runtime_mode get_runtime_mode() noexcept {
+    auto mode = current_runtime_mode.load(std::memory_order_acquire);
+    if (mode == runtime_mode_unset) {
+        std::call_once(runtime_options_once, parse_runtime_options);
+        mode = current_runtime_mode.load(std::memory_order_acquire);
+    }
+    return static_cast<runtime_mode>(mode);
+}
+
+// In passthrough mode, the global operators new and delete only call malloc and free.
+bool is_passthrough() noexcept { return get_runtime_mode() == runtime_mode::passthrough; }
+// \}
+
+template <> memory_manager &memory_manager::instance() noexcept {
+    if (current_runtime_mode.load(std::memory_order_relaxed) == runtime_mode_unset) {
+        get_runtime_mode();
+    }
+    return manager_storage.manager;
+}
+
+// Allocation entry points with the call site of the allocation.
+// \{
+void *allocate_at(std::size_t count, void const *site, std::nothrow_t const & /*unused*/) noexcept {
+    return memory_manager::instance().allocate(count, site);
+}
+
+void *allocate_at(std::size_t count, void const *site) {
+    void *ptr = memory_manager::instance().allocate(count, site);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+// \}
+
+// Entry points of the global operators new and delete (passthrough or allocation with the call site).
+// \{
+void *operator_new(std::size_t count, void const *site) {
+    if (is_passthrough()) {
+        void *ptr = malloc_allocate(std::max<std::size_t>(count, 1), std::nothrow);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+    return allocate_at(count, site);
+}
+
+void *operator_new(std::size_t count, void const *site, std::nothrow_t const & /*unused*/) noexcept {
+    if (is_passthrough()) {
+        return malloc_allocate(std::max<std::size_t>(count, 1), std::nothrow);
+    }
+    return allocate_at(count, site, std::nothrow);
+}
+
+void operator_delete(void *ptr) noexcept {
+    if (is_passthrough()) {
+        malloc_deallocate(ptr);
+        return;
+    }
+    memory_manager::instance().deallocate(ptr);
+}
+// \}
+
+// Per-thread cache of the memory blocks used by handler allocations.
+// Handler sizes are rounded up to a multiple of `granularity` so that a cached block can be reused by any handler of
+// the same size class.
+class handler_cache {
+  public:
+    static std::size_t const granularity = 64;
+    static std::size_t const size_classes = max_recycled_handler_size / granularity;
+    static std::size_t const slots = 4;
+
+    handler_cache() noexcept = default;
+    ~handler_cache() {
+        for (auto &slot : m_slots) {
+            for (std::size_t i = 0; i != slot.count; ++i) {
+                malloc_deallocate(slot.blocks.at(i));
+            }
+            slot.count = 0;
+        }
+        // The handlers allocated or deallocated later by the thread (e.g. by the destructors of other thread_local
+        // objects) bypass the cache.
+        thread_finished = true;
+    }
+
+    handler_cache(handler_cache const & /*unused*/) = delete;
+    handler_cache(handler_cache && /*unused*/) = delete;
+    handler_cache &operator=(handler_cache const & /*unused*/) = delete;
+    handler_cache &operator=(handler_cache && /*unused*/) = delete;
+
+    // Returns nullptr if the allocation fails.
+    void *allocate(std::size_t count, void const *site) noexcept {
+        auto &manager = memory_manager::instance();
+        if (thread_finished || count == 0 || count > max_recycled_handler_size) {
+            return manager.allocate(count, site);
+        }
+
+        auto &slot = m_slots.at(size_class(count));
+        if (slot.count != 0) {
+            // The block stays in the cache if the allocation fails.
+            void *ptr = manager.allocate(count, slot.blocks.at(slot.count - 1), site);
+            if (ptr != nullptr) {
+                --slot.count;
+                recycled_allocations.fetch_add(1, std::memory_order_relaxed);
+            }
+            return ptr;
+        }
+
+        void *allocation_ptr = malloc_allocate(
+            sizeof(memory_manager::allocation_object) + (size_class(count) + 1) * granularity, std::nothrow);
+        if (allocation_ptr == nullptr) {
+            return nullptr;
+        }
+        void *ptr = manager.allocate(count, allocation_ptr, site);
+        if (ptr == nullptr) {
+            malloc_deallocate(allocation_ptr);
+            return nullptr;
+        }
+        fresh_allocations.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    void deallocate(void *ptr, std::size_t count) noexcept {
+        auto manager = &memory_manager::instance();
+        if (thread_finished || count == 0 || count > max_recycled_handler_size) {
+            manager->deallocate(ptr);
+            return;
+        }
+
+        void *allocation_ptr = manager->release(ptr);
+        if (allocation_ptr == nullptr) {
+            return;
+        }
+        auto &slot = m_slots.at(size_class(count));
+        if (slot.count != slot.blocks.size()) {
+            slot.blocks.at(slot.count++) = allocation_ptr;
+        } else {
+            malloc_deallocate(allocation_ptr);
+            released_blocks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static std::atomic<std::uint64_t> fresh_allocations;
+    static std::atomic<std::uint64_t> recycled_allocations;
+    static std::atomic<std::uint64_t> released_blocks;
+
+  private:
+    static std::size_t size_class(std::size_t count) noexcept { return (count - 1) / granularity; }
+
+    struct slot_type {
+        std::array<void *, slots> blocks;
+        std::size_t count;
+    };
+    std::array<slot_type, size_classes> m_slots{};
+    // Set once the cache of the thread is destroyed (outside of it: the stores made by a destructor to the members of
+    // its object may be removed by the optimizer).
+    static thread_local bool thread_finished;
+};
+
+std::atomic<std::uint64_t> handler_cache::fresh_allocations{};
+std::atomic<std::uint64_t> handler_cache::recycled_allocations{};
+std::atomic<std::uint64_t> handler_cache::released_blocks{};
+thread_local bool handler_cache::thread_finished = false;
+
+thread_local handler_cache thread_handler_cache;
+
+} // namespace detail
+
+std::uint64_t total_allocations() noexcept {
+    return detail::memory_manager::instance().total_allocations();
+}
+
+std::uint64_t live_allocations() noexcept {
+    return detail::memory_manager::instance().live_allocations();
+}
+
+std::uint64_t max_allocated_size() noexcept {
+    return detail::memory_manager::instance().max_allocated_size();
+}
+
+std::uint64_t allocated_size() noexcept {
+    return detail::memory_manager::instance().allocated_size();
+}
+
+allocation_counters thread_allocation_counters() noexcept { return detail::thread_counters; }
+
+void set_error_countdown(std::uint64_t countdown) noexcept {
+    detail::memory_manager::instance().set_error_countdown(countdown);
+}
+
+std::uint64_t get_error_countdown() noexcept {
+    return detail::memory_manager::instance().get_error_countdown();
+}
+
+void pause_error_testing() noexcept {
+    detail::memory_manager::instance().pause_error_testing();
+}
+
+void resume_error_testing() noexcept {
+    detail::memory_manager::instance().resume_error_testing();
+}
+
+bool is_error_testing() noexcept {
+    return detail::memory_manager::instance().is_error_testing();
+}
+
+void error_point() {
+    if (!detail::memory_manager::instance().error_point()) {
+        throw std::bad_alloc();
+    }
+}
+
+bool error_point(std::nothrow_t const & /*unused*/) noexcept {
+    return detail::memory_manager::instance().error_point();
+}
+
+void *allocate(std::size_t count, std::nothrow_t const & /*unused*/) noexcept {
+    return detail::memory_manager::instance().allocate(count, DEV_NEW_RETURN_ADDRESS());
+}
+
+void *allocate(std::size_t count) { return detail::allocate_at(count, DEV_NEW_RETURN_ADDRESS()); }
+
+bool allocate_batch(std::size_t count, std::size_t n, void **ptrs, std::nothrow_t const & /*unused*/) noexcept {
+    return detail::memory_manager::instance().allocate_batch(count, n, ptrs, DEV_NEW_RETURN_ADDRESS());
+}
+
+void allocate_batch(std::size_t count, std::size_t n, void **ptrs) {
+    if (!detail::memory_manager::instance().allocate_batch(count, n, ptrs, DEV_NEW_RETURN_ADDRESS())) {
+        throw std::bad_alloc();
+    }
+}
+
+void deallocate_batch(void *const *ptrs, std::size_t n) noexcept {
+    detail::memory_manager::instance().deallocate_batch(ptrs, n);
+}
+
+category_scope::category_scope(char const *name) noexcept {
+    detail::current_thread_categories.push(detail::register_category(name));
+}
+
+category_scope::~category_scope() { detail::current_thread_categories.pop(); }
+
+operation_attribution::operation_attribution(char const *name) noexcept
+    : m_name{name}, m_id{detail::memory_manager::instance().add_operation()} {}
+
+operation_attribution::~operation_attribution() {
+    auto statistics = detail::memory_manager::instance().remove_operation(m_id);
+    if (auto observer = detail::current_operation_observer.load(std::memory_order_acquire)) {
+        observer(m_name, statistics);
+    }
+}
+
+operation_statistics operation_attribution::statistics() const noexcept {
+    return detail::memory_manager::instance().get_operation_statistics(m_id);
+}
+
+operation_scope::operation_scope(operation_attribution const &operation) noexcept
+    : m_previous{detail::current_operation} {
+    detail::current_operation = operation.m_id;
+}
+
+operation_scope::~operation_scope() { detail::current_operation = m_previous; }
+
+void set_operation_observer(operation_observer observer) noexcept {
+    detail::current_operation_observer.store(observer, std::memory_order_release);
+}
+
+void print_operation_statistics(char const *name, operation_statistics const &statistics) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(stderr,
+                 "dev_new operation %s: allocations: %" PRIu64 " allocated bytes: %" PRIu64 " peak bytes: %" PRIu64
+                 " live bytes: %" PRIu64 "\n",
+                 name, statistics.total_allocations, statistics.total_allocated_size, statistics.max_allocated_size,
+                 statistics.allocated_size);
+}
+
+arena_scope::arena_scope(std::size_t block_size) noexcept
+    : m_arena{detail::memory_manager::instance().add_arena(block_size)}, m_previous{detail::current_arena} {
+    if (m_arena != nullptr) {
+        detail::current_arena = m_arena;
+    }
+}
+
+arena_scope::~arena_scope() {
+    if (m_arena != nullptr) {
+        detail::current_arena = m_previous;
+        detail::memory_manager::instance().remove_arena(m_arena);
+    }
+}
+
+arena_counters arena_scope::statistics() const noexcept {
+    if (m_arena == nullptr) {
+        return arena_counters{};
+    }
+    return detail::memory_manager::instance().get_arena_counters(*m_arena);
+}
+
+arena_leftover_counters arena_leftover_statistics() noexcept {
+    return detail::memory_manager::instance().get_arena_leftover_counters();
+}
+
+std::uint64_t latency_bucket_lower_bound(std::size_t bucket) noexcept {
+    if (bucket < 8) {
+        return bucket;
+    }
+    auto width = (bucket - 8) / 4 + 4;
+    return static_cast<std::uint64_t>(4 + (bucket - 8) % 4) << (width - 3);
+}
+
+std::uint64_t latency_percentile(latency_histogram const &histogram, double fraction) noexcept {
+    auto rank = static_cast<std::uint64_t>(fraction * static_cast<double>(histogram.count));
+    std::uint64_t count = 0;
+    for (std::size_t bucket = 0; bucket != latency_buckets; ++bucket) {
+        count += histogram.buckets.at(bucket);
+        if (count > rank) {
+            return latency_bucket_lower_bound(bucket);
+        }
+    }
+    return histogram.max;
+}
+
+void set_self_profiling(bool enabled) noexcept { detail::memory_manager::instance().set_self_profiling(enabled); }
+
+bool is_self_profiling() noexcept { return detail::self_profiling.load(std::memory_order_relaxed); }
+
+self_profile_statistics self_profile() noexcept {
+    self_profile_statistics statistics{};
+    for (std::size_t operation = 0; operation != profiled_operations; ++operation) {
+        statistics.operations.at(operation) = detail::profile_data.operations.at(operation).histogram();
+    }
+    statistics.lock_wait_nanoseconds = detail::profile_data.lock_wait_nanoseconds.histogram();
+    statistics.probe_lengths = detail::memory_manager::instance().get_probe_lengths();
+
+    statistics.ticks_per_nanosecond = 1;
+#if BOOST_ARCH_X86
+    auto start_ticks = detail::profile_data.start_ticks.load(std::memory_order_relaxed);
+    auto ticks = detail::now_ticks() - start_ticks;
+    auto nanoseconds =
+        detail::now_nanoseconds() - detail::profile_data.start_nanoseconds.load(std::memory_order_relaxed);
+    if (start_ticks != 0 && nanoseconds != 0) {
+        statistics.ticks_per_nanosecond = static_cast<double>(ticks) / static_cast<double>(nanoseconds);
+    }
+#endif
+    return statistics;
+}
+
+void print_self_profile(std::FILE *file) {
+    auto statistics = self_profile();
+    auto to_nanoseconds = [&](std::uint64_t ticks) {
+        return static_cast<double>(ticks) / statistics.ticks_per_nanosecond;
+    };
+
+    std::array<char const *, profiled_operations> const names{"allocate", "deallocate", "check_allocation",
+                                                              "error_point"};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "dev_new self profile (%.2f ticks/ns)\n%-18s %12s %14s %10s %10s %10s %10s %12s\n",
+                 statistics.ticks_per_nanosecond, "operation", "calls", "total ms", "mean ns", "p50 ns", "p99 ns",
+                 "p99.9 ns", "max ns");
+    auto print_histogram = [&](char const *name, latency_histogram const &histogram, auto const &nanoseconds) {
+        if (histogram.count == 0) {
+            return;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-18s %12" PRIu64 " %14.3f %10.0f %10.0f %10.0f %10.0f %12.0f\n", name, histogram.count,
+                     nanoseconds(histogram.total) / 1e6,
+                     nanoseconds(histogram.total) / static_cast<double>(histogram.count),
+                     nanoseconds(latency_percentile(histogram, 0.5)), nanoseconds(latency_percentile(histogram, 0.99)),
+                     nanoseconds(latency_percentile(histogram, 0.999)), nanoseconds(histogram.max));
+    };
+    for (std::size_t operation = 0; operation != profiled_operations; ++operation) {
+        print_histogram(names.at(operation), statistics.operations.at(operation), to_nanoseconds);
+    }
+    print_histogram("lock wait", statistics.lock_wait_nanoseconds,
+                    [](std::uint64_t nanoseconds) { return static_cast<double>(nanoseconds); });
+
+    std::uint64_t lookups = 0;
+    std::uint64_t probes = 0;
+    for (std::size_t length = 0; length != probe_length_buckets; ++length) {
+        lookups += statistics.probe_lengths.at(length);
+        probes += statistics.probe_lengths.at(length) * (length + 1);
+    }
+    if (lookups != 0) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file,
+                     "pointer table lookups: %" PRIu64 " mean probe length: %.2f probes of %zu or more: %" PRIu64 "\n",
+                     lookups, static_cast<double>(probes) / static_cast<double>(lookups), probe_length_buckets,
+                     statistics.probe_lengths.back());
+    }
+}
+
+void latency_recorder::record(std::uint64_t value) noexcept {
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(value, std::memory_order_relaxed);
+    auto max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+    m_buckets.at(detail::latency_bucket(value)).fetch_add(1, std::memory_order_relaxed);
+}
+
+latency_histogram latency_recorder::histogram() const noexcept {
+    latency_histogram histogram{};
+    histogram.count = m_count.load(std::memory_order_relaxed);
+    histogram.total = m_total.load(std::memory_order_relaxed);
+    histogram.max = m_max.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i != latency_buckets; ++i) {
+        histogram.buckets.at(i) = m_buckets.at(i).load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+void print_latency_percentiles(std::FILE *file, char const *name, latency_histogram const &histogram) {
+    auto mean = histogram.count != 0 ? static_cast<double>(histogram.total) / static_cast<double>(histogram.count) : 0;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file,
+                 "%s: %" PRIu64 " samples, mean %.0f ns, p50 %" PRIu64 " ns, p90 %" PRIu64 " ns, p99 %" PRIu64
+                 " ns, p99.9 %" PRIu64 " ns, max %" PRIu64 " ns\n",
+                 name, histogram.count, mean, latency_percentile(histogram, 0.5), latency_percentile(histogram, 0.9),
+                 latency_percentile(histogram, 0.99), latency_percentile(histogram, 0.999), histogram.max);
+}
+
+void set_latency_injection(latency_injection_policy const &policy) noexcept {
+    std::lock_guard<std::mutex> lock(detail::latency_injection_mutex);
+    detail::latency_injection = policy;
+    detail::latency_injection_totals = latency_injection_counters{};
+    detail::latency_injection_random = policy.seed;
+    detail::latency_injection_allocations = 0;
+    detail::latency_injection_enabled.store(true, std::memory_order_relaxed);
+}
+
+void clear_latency_injection() noexcept {
+    std::lock_guard<std::mutex> lock(detail::latency_injection_mutex);
+    detail::latency_injection_enabled.store(false, std::memory_order_relaxed);
+}
+
+latency_injection_counters latency_injection_statistics() noexcept {
+    std::lock_guard<std::mutex> lock(detail::latency_injection_mutex);
+    return detail::latency_injection_totals;
+}
+
+std::size_t register_observer(allocation_observer observer, void *context) {
+    return observer != nullptr ? detail::event_observers.add(observer, context) : 0;
+}
+
+void unregister_observer(std::size_t id) { detail::event_observers.remove(id); }
+
+void flush_allocation_events() { detail::event_observers.flush(); }
+
+allocation_event_counters allocation_event_statistics() noexcept { return detail::event_observers.statistics(); }
+
+namespace {
+
+// Calls a function with the statistics of each category that had allocations (without allocating).
+// The live and maximum sizes of a category are given by a function of its id.
+template <typename S, typename F> void for_each_category_statistics(S const &category_size, F const &f) {
+    auto count = detail::category_count.load(std::memory_order_acquire);
+    for (std::size_t id = 0; id != max_categories; ++id) {
+        if (id == count) {
+            id = detail::overflow_category;
+        }
+        category_statistics category{detail::category_name(id), 0, 0, 0, 0, 0};
+        auto add_counters = [&](detail::category_table const &table) {
+            auto &counters = table.counters.at(id);
+            category.total_allocations += counters.total_allocations.load(std::memory_order_relaxed);
+            category.total_deallocations += counters.total_deallocations.load(std::memory_order_relaxed);
+            category.total_allocated_size += counters.total_allocated_size.load(std::memory_order_relaxed);
+        };
+        for (auto table = detail::category_tables.load(std::memory_order_acquire); table != nullptr;
+             table = table->next) {
+            add_counters(*table);
+        }
+        add_counters(detail::shared_category_table);
+        if (category.total_allocations == 0) {
+            continue;
+        }
+        auto size = category_size(static_cast<std::uint16_t>(id));
+        category.allocated_size = size.allocated_size;
+        category.max_allocated_size = size.max_allocated_size;
+        f(category);
+    }
+}
+
+} // namespace
+
+std::vector<category_statistics> categories_statistics() {
+    std::vector<category_statistics> statistics;
+    auto &manager = detail::memory_manager::instance();
+    for_each_category_statistics([&](std::uint16_t id) { return manager.get_category_size(id); },
+                                 [&](category_statistics const &category) { statistics.push_back(category); });
+    return statistics;
+}
+
+void print_category_report(std::FILE *file) {
+    auto statistics = categories_statistics();
+    std::sort(statistics.begin(), statistics.end(), [](auto const &a, auto const &b) {
+        return a.total_allocated_size > b.total_allocated_size;
+    });
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "%-24s %12s %12s %14s %14s %16s\n", "category", "allocations", "deallocations", "live bytes",
+                 "peak bytes", "churn bytes");
+    for (auto const &category : statistics) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-24s %12" PRIu64 " %12" PRIu64 " %14" PRIu64 " %14" PRIu64 " %16" PRIu64 "\n",
+                     category.name, category.total_allocations, category.total_deallocations, category.allocated_size,
+                     category.max_allocated_size, category.total_allocated_size);
+    }
+}
+
+std::vector<lifetime_statistics> size_class_lifetimes() {
+    std::vector<lifetime_statistics> lifetimes;
+    lifetimes.reserve(lifetime_buckets);
+    for (std::size_t size_class = 0; size_class != lifetime_buckets; ++size_class) {
+        lifetimes.push_back(detail::memory_manager::instance().get_size_class_lifetimes(size_class));
+    }
+    return lifetimes;
+}
+
+std::vector<site_lifetime_statistics> site_lifetimes() {
+    auto &manager = detail::memory_manager::instance();
+    // The statistics are copied under the lock, in a vector allocated beforehand.
+    std::vector<site_lifetime_statistics> sites(manager.get_lifetime_site_count());
+    sites.resize(manager.copy_site_lifetimes(sites.data(), sites.size()));
+    return sites;
+}
+
+namespace {
+
+// Returns the fraction of the lifetimes not longer than a maximum.
+double short_lifetime_fraction(lifetime_histogram const &histogram, std::uint64_t deallocations,
+                               std::uint64_t max_lifetime) {
+    std::uint64_t short_lifetimes = histogram.at(0);
+    for (std::size_t bucket = 1; bucket != lifetime_buckets - 1 && (std::uint64_t{1} << bucket) - 1 <= max_lifetime;
+         ++bucket) {
+        short_lifetimes += histogram.at(bucket);
+    }
+    return static_cast<double>(short_lifetimes) / static_cast<double>(deallocations);
+}
+
+// Returns the upper bound of the bucket holding the median lifetime.
+std::uint64_t median_lifetime_bound(lifetime_histogram const &histogram, std::uint64_t deallocations) {
+    std::uint64_t count = 0;
+    for (std::size_t bucket = 0; bucket != lifetime_buckets; ++bucket) {
+        count += histogram.at(bucket);
+        if (2 * count >= deallocations) {
+            return (std::uint64_t{1} << bucket) - 1;
+        }
+    }
+    return std::numeric_limits<std::uint64_t>::max();
+}
+
+} // namespace
+
+void print_lifetime_report(std::FILE *file, std::uint64_t max_ticks, double min_fraction) {
+    auto sites = site_lifetimes();
+    sites.erase(std::remove_if(sites.begin(), sites.end(),
+                               [&](auto const &site) {
+                                   return short_lifetime_fraction(site.lifetimes.ticks, site.lifetimes.deallocations,
+                                                                  max_ticks) < min_fraction;
+                               }),
+                sites.end());
+    std::sort(sites.begin(), sites.end(),
+              [](auto const &a, auto const &b) { return a.lifetimes.deallocations > b.lifetimes.deallocations; });
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "short-lived allocation sites (%.0f%% of the allocations freed within %" PRIu64 " ticks)\n",
+                 min_fraction * 100, max_ticks);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "%-18s %12s %8s %14s %16s\n", "site", "frees", "short", "median ticks", "median ns");
+    for (auto const &site : sites) {
+        auto const &lifetimes = site.lifetimes;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-18p %12" PRIu64 " %7.1f%% %14" PRIu64 " %16" PRIu64 "\n", site.site,
+                     lifetimes.deallocations,
+                     short_lifetime_fraction(lifetimes.ticks, lifetimes.deallocations, max_ticks) * 100,
+                     median_lifetime_bound(lifetimes.ticks, lifetimes.deallocations),
+                     median_lifetime_bound(lifetimes.nanoseconds, lifetimes.deallocations));
+    }
+}
+
+std::vector<growth_site> growth_sites() {
+    std::vector<growth_site> sites;
+    sites.reserve(detail::growth_table::max_sites / 2 + 1);
+    detail::growth_steps.for_each([&](growth_site const &site) { sites.push_back(site); });
+    std::sort(sites.begin(), sites.end(), [](auto const &a, auto const &b) { return a.copied_size > b.copied_size; });
+    return sites;
+}
+
+void print_growth_report(std::FILE *file, std::size_t max_sites) {
+    auto sites = growth_sites();
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "growth steps (candidates for reserve())\n%-18s %12s %16s %14s\n", "site", "steps",
+                 "copied bytes", "max size");
+    for (std::size_t i = 0; i != std::min(max_sites, sites.size()); ++i) {
+        auto const &site = sites.at(i);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-18p %12" PRIu64 " %16" PRIu64 " %14" PRIu64 "\n", site.site, site.growth_steps,
+                     site.copied_size, site.max_size);
+    }
+}
+
+#if BOOST_OS_LINUX
+namespace {
+
+// Publishing thread of the shared memory statistics segment (see publish_statistics()).
+// The buffers used to take the snapshots are allocated when publishing starts, so that publishing doesn't allocate.
+class statistics_publisher {
+  public:
+    statistics_publisher() = default;
+    ~statistics_publisher() { stop(); }
+
+    statistics_publisher(statistics_publisher const & /*unused*/) = delete;
+    statistics_publisher(statistics_publisher && /*unused*/) = delete;
+    statistics_publisher &operator=(statistics_publisher const & /*unused*/) = delete;
+    statistics_publisher &operator=(statistics_publisher && /*unused*/) = delete;
+
+    bool start(unsigned interval_milliseconds) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_thread.joinable()) {
+            return true;
+        }
+        if (!open()) {
+            return false;
+        }
+        m_interval = std::chrono::milliseconds(interval_milliseconds);
+        m_stop = false;
+        publish();
+        try {
+            m_thread = std::thread([this] { run(); });
+        } catch (std::exception const &) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_thread.joinable()) {
+                return;
+            }
+            m_stop = true;
+        }
+        m_stopping.notify_all();
+        m_thread.join();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        close();
+    }
+
+  private:
+    bool open() noexcept {
+        m_name = stats_segment::name(static_cast<std::uint64_t>(getpid()));
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg, hicpp-signed-bitwise)
+        int fd = shm_open(m_name.data(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd == -1) {
+            return false;
+        }
+        void *memory = MAP_FAILED;
+        if (ftruncate(fd, sizeof(stats_segment::segment)) == 0) {
+            // NOLINTNEXTLINE(hicpp-signed-bitwise)
+            memory = mmap(nullptr, sizeof(stats_segment::segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            shm_unlink(m_name.data());
+            return false;
+        }
+        // The mapping is zero-filled.
+        m_segment = static_cast<stats_segment::segment *>(memory);
+        m_segment->magic = stats_segment::magic;
+        m_segment->version = stats_segment::version;
+        m_snapshot = stats_segment::snapshot{};
+        return true;
+    }
+
+    void close() noexcept {
+        munmap(m_segment, sizeof(stats_segment::segment));
+        m_segment = nullptr;
+        shm_unlink(m_name.data());
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping.wait_for(lock, m_interval, [this] { return m_stop; })) {
+            publish();
+        }
+    }
+
+    // Takes a snapshot and writes it to the segment (with m_mutex held).
+    void publish() noexcept {
+        auto &data = m_snapshot;
+        data.pid = static_cast<std::uint64_t>(getpid());
+        ++data.publications;
+        data.time_nanoseconds = detail::now_nanoseconds();
+        auto site_count = detail::memory_manager::instance().copy_published_statistics(
+            data, m_category_sizes, m_sites.data(), m_sites.size());
+
+        // The totals of the categories are read from the category tables of the threads.
+        std::size_t category_count = 0;
+        for_each_category_statistics([&](std::uint16_t id) { return m_category_sizes.at(id); },
+                                     [&](category_statistics const &category) {
+                                         m_categories.at(category_count++) = category;
+                                     });
+        data.category_count = std::min(category_count, stats_segment::max_categories);
+        std::partial_sort(m_categories.begin(), m_categories.begin() + data.category_count,
+                          m_categories.begin() + category_count, [](auto const &a, auto const &b) {
+                              return a.total_allocated_size > b.total_allocated_size;
+                          });
+        for (std::size_t i = 0; i != data.category_count; ++i) {
+            auto const &category = m_categories.at(i);
+            auto &published = data.categories.at(i);
+            published = stats_segment::category{{}, category.total_allocations, category.total_deallocations,
+                                                category.allocated_size, category.max_allocated_size,
+                                                category.total_allocated_size};
+            std::strncpy(published.name.data(), category.name, published.name.size() - 1);
+        }
+
+        // The sites are copied with the most deallocations first.
+        data.site_count = site_count;
+        for (std::size_t i = 0; i != data.site_count; ++i) {
+            auto const &site = m_sites.at(i);
+            auto const &lifetimes = site.lifetimes;
+            data.sites.at(i) = stats_segment::site{
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                reinterpret_cast<std::uintptr_t>(site.site), lifetimes.deallocations,
+                median_lifetime_bound(lifetimes.nanoseconds, lifetimes.deallocations),
+                median_lifetime_bound(lifetimes.ticks, lifetimes.deallocations)};
+        }
+
+        stats_segment::write(*m_segment, data);
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_stopping;
+    bool m_stop{};
+    std::thread m_thread;
+    std::chrono::milliseconds m_interval{};
+    std::array<char, 32> m_name{};
+    stats_segment::segment *m_segment{};
+    stats_segment::snapshot m_snapshot{};
+    std::array<detail::memory_manager::category_size, max_categories> m_category_sizes{};
+    std::array<category_statistics, max_categories> m_categories{};
+    std::array<site_lifetime_statistics, stats_segment::max_sites> m_sites{};
+};
+
+statistics_publisher publisher;
+
+} // namespace
+
+bool publish_statistics(unsigned interval_milliseconds) { return publisher.start(interval_milliseconds); }
+
+void stop_publishing_statistics() { publisher.stop(); }
+#else
+bool publish_statistics(unsigned /*unused*/) { return false; }
+
+void stop_publishing_statistics() {}
+#endif
+
+leak_report find_leaks(unsigned thread_count) {
+    leak_report report{};
+#if BOOST_OS_LINUX
+    detail::leak_scanner scanner;
+    if (!detail::memory_manager::instance().scan_leaks(scanner, thread_count)) {
+        throw std::bad_alloc();
+    }
+    report.live_allocations = scanner.live_allocations();
+    report.leaked_allocations = scanner.leaked_allocations();
+    report.leaked_size = scanner.leaked_size();
+    report.scanned_size = scanner.scanned_size();
+    report.threads = scanner.thread_count();
+    report.other_threads = scanner.other_threads();
+    report.complete = report.other_threads == 0;
+    if (!report.complete) {
+        report.live_allocations = live_allocations();
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    report.sites.assign(scanner.leaks(), scanner.leaks() + scanner.leak_site_count());
+#else
+    static_cast<void>(thread_count);
+#endif
+    return report;
+}
+
+overhead_counters overhead_statistics() noexcept { return detail::memory_manager::instance().get_overhead_counters(); }
+
+void print_overhead_report(std::FILE *file) {
+    auto counters = overhead_statistics();
+    auto footprint = counters.allocated_size + counters.header_size + counters.metadata_size + counters.slack_size;
+    auto print = [&](char const *name, std::uint64_t size) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-16s %14" PRIu64 " bytes %6.1f%%\n", name, size,
+                     footprint != 0 ? static_cast<double>(size) * 100 / static_cast<double>(footprint) : 0.0);
+    };
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "memory overhead\n");
+    print("allocated", counters.allocated_size);
+    print("headers", counters.header_size);
+    print("metadata", counters.metadata_size);
+    print("slack", counters.slack_size);
+    print("footprint", footprint);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "%-16s %14" PRIu64 " bytes\n%-16s %14" PRIu64 " bytes\n", "resident", counters.resident_size,
+                 "virtual", counters.virtual_size);
+}
+
+void print_leak_report(std::FILE *file, leak_report const &report) {
+    if (!report.complete) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "leak scan not run (%u other threads running)\n", report.other_threads);
+        return;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file,
+                 "leaked allocations: %" PRIu64 " of %" PRIu64 " live (%" PRIu64 " bytes, %" PRIu64
+                 " bytes scanned by %u threads)\n",
+                 report.leaked_allocations, report.live_allocations, report.leaked_size, report.scanned_size,
+                 report.threads);
+    if (report.sites.empty()) {
+        return;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "%-18s %12s %14s\n", "site", "allocations", "bytes");
+    for (auto const &site : report.sites) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-18p %12" PRIu64 " %14" PRIu64 "\n", site.site, site.allocations, site.size);
+    }
+}
+
+heap_snapshot snapshot() {
+    heap_snapshot result{{}, total_allocations()};
+    auto &manager = detail::memory_manager::instance();
+    // The buffer is sized for the current live allocations and grown if there are more once the lock is taken.
+    for (auto capacity = static_cast<std::size_t>(live_allocations()) + 64;;) {
+        result.allocations.resize(capacity);
+        auto count = manager.copy_live_allocations(result.allocations.data(), capacity);
+        if (count <= capacity) {
+            result.allocations.resize(count);
+            break;
+        }
+        capacity = count + count / 8;
+    }
+    std::sort(result.allocations.begin(), result.allocations.end(),
+              [](auto const &a, auto const &b) { return a.ptr < b.ptr; });
+    return result;
+}
+
+snapshot_diff diff(heap_snapshot const &before, heap_snapshot const &after) {
+    snapshot_diff result{0, 0, 0, 0, {}};
+    auto same = [](snapshot_allocation const &a, snapshot_allocation const &b) {
+        return a.ptr == b.ptr && a.size == b.size && a.site == b.site && a.category == b.category;
+    };
+    std::vector<snapshot_allocation> grown;
+    auto b = before.allocations.begin();
+    for (auto const &allocation : after.allocations) {
+        for (; b != before.allocations.end() && b->ptr < allocation.ptr; ++b) {
+            ++result.freed_allocations;
+            result.freed_size += b->size;
+        }
+        if (b != before.allocations.end() && same(*b, allocation)) {
+            ++b;
+            continue;
+        }
+        if (b != before.allocations.end() && b->ptr == allocation.ptr) {
+            // The address was freed and reused.
+            ++result.freed_allocations;
+            result.freed_size += b->size;
+            ++b;
+        }
+        ++result.allocations;
+        result.size += allocation.size;
+        grown.push_back(allocation);
+    }
+    for (; b != before.allocations.end(); ++b) {
+        ++result.freed_allocations;
+        result.freed_size += b->size;
+    }
+
+    std::sort(grown.begin(), grown.end(), [](auto const &x, auto const &y) {
+        return std::tie(x.site, x.category) < std::tie(y.site, y.category);
+    });
+    for (auto const &allocation : grown) {
+        auto category = detail::category_name(allocation.category);
+        if (result.sites.empty() || result.sites.back().site != allocation.site ||
+            result.sites.back().category != category) {
+            result.sites.push_back(snapshot_site_growth{allocation.site, category, 0, 0});
+        }
+        ++result.sites.back().allocations;
+        result.sites.back().size += allocation.size;
+    }
+    std::sort(result.sites.begin(), result.sites.end(), [](auto const &x, auto const &y) { return x.size > y.size; });
+    return result;
+}
+
+void print_snapshot_diff(std::FILE *file, snapshot_diff const &diff) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file,
+                 "allocated and not freed: %" PRIu64 " (%" PRIu64 " bytes), freed: %" PRIu64 " (%" PRIu64
+                 " bytes)\n",
+                 diff.allocations, diff.size, diff.freed_allocations, diff.freed_size);
+    if (diff.sites.empty()) {
+        return;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file, "%-18s %-32s %12s %14s\n", "site", "category", "allocations", "bytes");
+    for (auto const &site : diff.sites) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::fprintf(file, "%-18p %-32s %12" PRIu64 " %14" PRIu64 "\n", site.site, site.category, site.allocations,
+                     site.size);
+    }
+}
+
+void *allocate_handler(std::size_t count) {
+    void *ptr = detail::thread_handler_cache.allocate(count, DEV_NEW_RETURN_ADDRESS());
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void deallocate_handler(void *ptr, std::size_t count) noexcept { detail::thread_handler_cache.deallocate(ptr, count); }
+
+handler_recycling_counters handler_allocation_counters() noexcept {
+    using detail::handler_cache;
+    auto fresh_allocations = handler_cache::fresh_allocations.load(std::memory_order_relaxed);
+    auto recycled_allocations = handler_cache::recycled_allocations.load(std::memory_order_relaxed);
+    return handler_recycling_counters{fresh_allocations + recycled_allocations, recycled_allocations,
+                                      handler_cache::released_blocks.load(std::memory_order_relaxed)};
+}
+
+void deallocate(void *ptr) noexcept {
+    detail::memory_manager::instance().deallocate(ptr);
+}
+
+void set_large_allocation_threshold(std::size_t threshold) noexcept {
+    detail::memory_manager::instance().set_large_allocation_threshold(threshold);
+}
+
+std::size_t get_large_allocation_threshold() noexcept {
+    return detail::memory_manager::instance().get_large_allocation_threshold();
+}
+
+large_allocation_counters large_allocation_statistics() noexcept {
+    return detail::memory_manager::instance().get_large_allocation_counters();
+}
+
+remote_free_counters remote_free_statistics() noexcept {
+    return detail::memory_manager::instance().get_remote_free_counters();
+}
+
+lock_counters lock_statistics() noexcept {
+    return detail::memory_manager::instance().get_lock_counters();
+}
+
+void check_allocation(void *ptr) {
+    if (!detail::memory_manager::instance().check_allocation(ptr)) {
+        throw std::domain_error("dev_new: pointer not allocated by this allocator");
+    }
+}
+
+bool check_allocation(void *ptr, std::nothrow_t const & /*unused*/) noexcept {
+    return detail::memory_manager::instance().check_allocation(ptr);
+}
+
+void const *allocation_site(void *ptr) noexcept {
+    return detail::memory_manager::instance().get_allocation_site(ptr);
+}
+
+runtime_mode get_runtime_mode() noexcept { return detail::get_runtime_mode(); }
+
+feature_set features() noexcept {
+    using features = detail::configured_features;
+    return feature_set{features::tracking,      features::error_injection, features::statistics,
+                       features::stack_capture, features::fill_patterns,   features::lifetimes};
+}
+
+} // namespace dev_new
+
+void *operator new(std::size_t count) { return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS()); }
+void *operator new[](std::size_t count) { return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS()); }
+void *operator new(std::size_t count, std::align_val_t /*unused*/) {
+    return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS());
+}
+void *operator new[](std::size_t count, std::align_val_t /*unused*/) {
+    return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS());
+}
 void *operator new(std::size_t count, std::nothrow_t const & /*unused*/) noexcept {
-    return dev_new::allocate(count, std::nothrow);
+    return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS(), std::nothrow);
 }
 void *operator new[](std::size_t count, std::nothrow_t const & /*unused*/) noexcept {
-    return dev_new::allocate(count, std::nothrow);
+    return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS(), std::nothrow);
 }
 void *operator new(std::size_t count, std::align_val_t /*unused*/, std::nothrow_t const & /*unused*/) noexcept {
-    return dev_new::allocate(count, std::nothrow);
+    return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS(), std::nothrow);
 }
 void *operator new[](std::size_t count, std::align_val_t /*unused*/, std::nothrow_t const & /*unused*/) noexcept {
-    return dev_new::allocate(count, std::nothrow);
+    return dev_new::detail::operator_new(count, DEV_NEW_RETURN_ADDRESS(), std::nothrow);
 }
 
-void operator delete(void *ptr) noexcept { dev_new::deallocate(ptr); }
-void operator delete[](void *ptr) noexcept { dev_new::deallocate(ptr); }
-void operator delete(void *ptr, std::align_val_t /*unused*/) noexcept { dev_new::deallocate(ptr); }
-void operator delete[](void *ptr, std::align_val_t /*unused*/) noexcept { dev_new::deallocate(ptr); }
-void operator delete(void *ptr, std::size_t /*unused*/) noexcept { dev_new::deallocate(ptr); }
-void operator delete[](void *ptr, std::size_t /*unused*/) noexcept { dev_new::deallocate(ptr); }
+void operator delete(void *ptr) noexcept { dev_new::detail::operator_delete(ptr); }
+void operator delete[](void *ptr) noexcept { dev_new::detail::operator_delete(ptr); }
+void operator delete(void *ptr, std::align_val_t /*unused*/) noexcept { dev_new::detail::operator_delete(ptr); }
+void operator delete[](void *ptr, std::align_val_t /*unused*/) noexcept { dev_new::detail::operator_delete(ptr); }
+void operator delete(void *ptr, std::size_t /*unused*/) noexcept { dev_new::detail::operator_delete(ptr); }
+void operator delete[](void *ptr, std::size_t /*unused*/) noexcept { dev_new::detail::operator_delete(ptr); }
 void operator delete(void *ptr, std::size_t /*unused*/, std::align_val_t /*unused*/) noexcept {
-    dev_new::deallocate(ptr);
+    dev_new::detail::operator_delete(ptr);
 }
 void operator delete[](void *ptr, std::size_t /*unused*/, std::align_val_t /*unused*/) noexcept {
-    dev_new::deallocate(ptr);
+    dev_new::detail::operator_delete(ptr);
 }
@@ -0,0 +1,120 @@
+#include "dev_new_pmr.hpp"
+
+#if DEV_NEW_HAS_PMR
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace dev_new {
+
+namespace detail {
+
+// Memory resource allocating with dev_new::allocate().
+// Over-aligned allocations are made by allocating extra memory and storing the allocated pointer just before the
+// aligned one.
+class global_memory_resource : public std::pmr::memory_resource {
+  protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (alignment <= alignof(std::max_align_t)) {
+            return dev_new::allocate(bytes);
+        }
+
+        auto ptr = static_cast<char *>(dev_new::allocate(bytes + alignment + sizeof(void *)));
+        auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        auto aligned_address = (address + sizeof(void *) + alignment - 1) & ~(alignment - 1);
+        auto aligned_ptr = ptr + (aligned_address - address);
+        *(reinterpret_cast<void **>(aligned_ptr) - 1) = ptr;
+        return aligned_ptr;
+    }
+
+    void do_deallocate(void *ptr, std::size_t /*unused*/, std::size_t alignment) override {
+        if (alignment <= alignof(std::max_align_t)) {
+            dev_new::deallocate(ptr);
+        } else {
+            dev_new::deallocate(*(static_cast<void **>(ptr) - 1));
+        }
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override { return this == &other; }
+};
+
+} // namespace detail
+
+std::pmr::memory_resource *global_resource() noexcept {
+    static detail::global_memory_resource resource;
+    return &resource;
+}
+
+tracked_resource::tracked_resource(std::pmr::memory_resource *upstream) noexcept
+    : m_upstream{upstream}, m_statistics{}, m_error_testing{}, m_error_countdown{UINT64_MAX},
+      m_error_allocated_size{UINT64_MAX} {}
+
+allocation_statistics tracked_resource::statistics() const noexcept {
+    lock_guard lock(m_mutex);
+    return m_statistics;
+}
+
+void tracked_resource::set_error_countdown(std::uint64_t countdown) noexcept {
+    lock_guard lock(m_mutex);
+    m_error_testing = true;
+    m_error_countdown = countdown;
+    m_error_allocated_size = m_statistics.allocated_size;
+}
+
+std::uint64_t tracked_resource::get_error_countdown() const noexcept {
+    lock_guard lock(m_mutex);
+    return m_error_countdown;
+}
+
+void tracked_resource::pause_error_testing() noexcept {
+    lock_guard lock(m_mutex);
+    m_error_testing = false;
+}
+
+void tracked_resource::resume_error_testing() noexcept {
+    lock_guard lock(m_mutex);
+    m_error_testing = true;
+}
+
+void *tracked_resource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    {
+        lock_guard lock(m_mutex);
+        if (m_error_testing) {
+            if (m_error_countdown > 1) {
+                --m_error_countdown;
+            } else if (m_error_countdown == 1) {
+                m_error_allocated_size = m_statistics.allocated_size;
+                m_error_countdown = 0;
+                throw std::bad_alloc();
+            } else if (m_statistics.allocated_size + bytes > m_error_allocated_size) {
+                throw std::bad_alloc();
+            }
+        }
+    }
+
+    void *ptr = m_upstream->allocate(bytes, alignment);
+
+    lock_guard lock(m_mutex);
+    ++m_statistics.total_allocations;
+    ++m_statistics.live_allocations;
+    m_statistics.allocated_size += bytes;
+    m_statistics.max_allocated_size = std::max(m_statistics.max_allocated_size, m_statistics.allocated_size);
+    return ptr;
+}
+
+void tracked_resource::do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) {
+    m_upstream->deallocate(ptr, bytes, alignment);
+
+    lock_guard lock(m_mutex);
+    DEV_NEW_ASSERT(m_statistics.live_allocations != 0 && bytes <= m_statistics.allocated_size);
+    --m_statistics.live_allocations;
+    m_statistics.allocated_size -= bytes;
+}
+
+bool tracked_resource::do_is_equal(std::pmr::memory_resource const &other) const noexcept { return this == &other; }
+
+} // namespace dev_new
+
+#endif
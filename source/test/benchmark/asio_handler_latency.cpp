@@ -0,0 +1,100 @@
+// Handler latencies under allocation latency injection.
+// A chain of posted handlers and a chain of 1ms timer waits run with each latency injection policy; the latency of a
+// posted handler is measured from its post and the one of a timer handler from its expiry.
+#include "dev_new.hpp"
+#include "dev_new_asio.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace asio = boost::asio;
+
+namespace {
+
+using error_code = boost::system::error_code;
+
+// Posts count handlers one after the other, each one making an allocation.
+void post_chain(asio::io_context &io_context, dev_new::latency_recorder &latencies, unsigned count) {
+    if (count == 0) {
+        return;
+    }
+    asio::post(io_context, dev_new::bind_latency(latencies, [&io_context, &latencies, count] {
+                   auto buffer = std::make_unique<std::vector<char>>(256);
+                   post_chain(io_context, latencies, count - 1);
+               }));
+}
+
+// Waits count times for a timer, recording the lateness of the handlers.
+void wait_chain(asio::steady_timer &timer, dev_new::latency_recorder &lateness, unsigned count) {
+    if (count == 0) {
+        return;
+    }
+    timer.expires_after(std::chrono::milliseconds(1));
+    timer.async_wait([&timer, &lateness, count](error_code /*unused*/) {
+        auto late = std::chrono::steady_clock::now() - timer.expiry();
+        lateness.record(
+            static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(late).count()));
+        auto buffer = std::make_unique<std::vector<char>>(256);
+        wait_chain(timer, lateness, count - 1);
+    });
+}
+
+void run_benchmark(char const *name, dev_new::latency_injection_policy const *policy) {
+    dev_new::latency_recorder post_latencies;
+    dev_new::latency_recorder timer_lateness;
+    {
+        asio::io_context io_context;
+        asio::steady_timer timer(io_context);
+        if (policy != nullptr) {
+            dev_new::set_latency_injection(*policy);
+        }
+        post_chain(io_context, post_latencies, 20000);
+        wait_chain(timer, timer_lateness, 200);
+        io_context.run();
+        dev_new::clear_latency_injection();
+    }
+    auto injection = dev_new::latency_injection_statistics();
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::printf("%s: %" PRIu64 " delayed allocations, %.3f ms of delays\n", name, injection.delayed_allocations,
+                static_cast<double>(injection.total_delay_nanoseconds) / 1e6);
+    dev_new::print_latency_percentiles(stdout, "  posted handlers", post_latencies.histogram());
+    dev_new::print_latency_percentiles(stdout, "  timer handlers (lateness)", timer_lateness.histogram());
+}
+
+} // namespace
+
+int main() {
+    run_benchmark("no injection", nullptr);
+
+    dev_new::latency_injection_policy policy{};
+    policy.distribution = dev_new::delay_distribution::fixed;
+    policy.max_delay_nanoseconds = 20000;
+    run_benchmark("fixed 20us", &policy);
+
+    policy.distribution = dev_new::delay_distribution::uniform;
+    policy.max_delay_nanoseconds = 100000;
+    policy.seed = 1;
+    run_benchmark("uniform up to 100us", &policy);
+
+    // A page fault storm like distribution: mostly fast allocations and a stall of about 1ms in a thousand.
+    policy.distribution = dev_new::delay_distribution::recorded;
+    policy.recorded.count = 1000;
+    policy.recorded.buckets.at(0) = 999;
+    std::size_t stall_bucket = 0;
+    while (dev_new::latency_bucket_lower_bound(stall_bucket + 1) <= 1000000) {
+        ++stall_bucket;
+    }
+    policy.recorded.buckets.at(stall_bucket) = 1;
+    run_benchmark("recorded (0.1% stalls)", &policy);
+
+    std::cout << "End execution. Live allocations: " << dev_new::live_allocations()
+              << " Total allocations: " << dev_new::total_allocations() << std::endl;
+    return dev_new::live_allocations() == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// Producer/consumer benchmark of cross-thread deallocations.
+// Producer threads allocate buffers and post them to a consumer io_context run by several threads (in the same way as
+// error_testing::run_io_context()), where they are freed.
+#include "dev_new.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+
+namespace {
+
+using buffer_t = std::vector<char>;
+
+/// Runs an io_context as long as it isn't stopped (see error_testing::run_io_context()).
+void run_io_context(asio::io_context &io_context) {
+    while (!io_context.stopped()) {
+        try {
+            io_context.run();
+        } catch (std::exception &e) {
+            std::cout << "io_context run error: " << e.what() << std::endl;
+        }
+    }
+}
+
+void run_benchmark(unsigned thread_count, unsigned messages_per_producer) {
+    asio::io_context producers;
+    asio::io_context consumers;
+    auto consumers_work = asio::make_work_guard(consumers.get_executor());
+
+    for (unsigned producer = 0; producer < thread_count; ++producer) {
+        asio::post(producers, [&consumers, messages_per_producer] {
+            for (unsigned message = 0; message < messages_per_producer; ++message) {
+                asio::post(consumers, [buffer = buffer_t(64 + message % 512)] { (void)buffer; });
+            }
+        });
+    }
+
+    auto remote_before = dev_new::remote_free_statistics();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(2 * thread_count);
+    for (unsigned i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&consumers] { run_io_context(consumers); });
+    }
+    for (unsigned i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&producers] { run_io_context(producers); });
+    }
+    for (unsigned i = 0; i < thread_count; ++i) {
+        threads[thread_count + i].join();
+    }
+    consumers_work.reset();
+    for (unsigned i = 0; i < thread_count; ++i) {
+        threads[i].join();
+    }
+    auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto remote_after = dev_new::remote_free_statistics();
+
+    auto messages = static_cast<double>(thread_count) * messages_per_producer;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::printf("threads: %2u messages: %8.0f time: %8.3fs messages/s: %10.0f remote frees: %8" PRIu64
+                " batches: %6" PRIu64 " max batch: %4" PRIu64 "\n",
+                thread_count, messages, duration, messages / duration,
+                remote_after.remote_frees - remote_before.remote_frees,
+                remote_after.drained_batches - remote_before.drained_batches, remote_after.max_batch_size);
+}
+
+} // namespace
+
+int main() {
+    for (unsigned thread_count : {1U, 2U, 4U, 8U}) {
+        run_benchmark(thread_count, 20000);
+    }
+    std::cout << "End execution. Live allocations: " << dev_new::live_allocations()
+              << " Total allocations: " << dev_new::total_allocations() << std::endl;
+    return dev_new::live_allocations() == 0 ? 0 : 1;
+}
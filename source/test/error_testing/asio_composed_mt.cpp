@@ -0,0 +1,227 @@
+// Multi-threaded error testing of a composed operation running many timer waits both in parallel and in series (see
+// asio_composed.cpp).
+// One composed operation runs on each strand of an io_context that is run by several threads. For each thread count,
+// the operations are run with errors raised at a few error countdowns and without errors, reporting the throughput
+// (timer waits per second), the allocator lock contention and whether the live allocations returned to their initial
+// count.
+// Only the 11 power-of-two error countdowns from 1 to 1024 are tested, not every countdown as in run_loop(): the error
+// points reached by the threads of a run depend on their scheduling, so the error paths are sampled rather than
+// enumerated.
+#include "dev_new.hpp"
+#include "run_loop.hpp"
+
+#include <atomic>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/predef.h>
+#include <boost/range/irange.hpp>
+#include <boost/scope_exit.hpp>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace asio = boost::asio;
+
+namespace {
+
+using error_code = boost::system::error_code;
+
+std::atomic<std::uint64_t> completed_waits{0};
+
+// The composed operation of asio_composed.cpp, with the timers waiting for up to 100 microseconds and allocating a
+// buffer on each completed wait (so that the operation stresses the allocator rather than the timer queue) and without
+// logging the internal waits.
+template <typename CompletionToken>
+auto async_many_timers(asio::io_context &io_context, bool &user_resource,
+                       std::chrono::steady_clock::duration run_duration, CompletionToken &&token) ->
+    typename asio::async_result<std::decay_t<CompletionToken>, void(error_code)>::return_type {
+
+    using completion_handler_sig = void(error_code);
+    using completion_type = asio::async_completion<CompletionToken, completion_handler_sig>;
+    using completion_handler_type = typename completion_type::completion_handler_type;
+
+    struct internal_state : public std::enable_shared_from_this<internal_state> {
+        internal_state(asio::io_context &io_context, bool &user_resource,
+                       completion_handler_type user_completion_handler)
+            : io_context{io_context}, user_resource{user_resource},
+              user_completion_handler{std::move(user_completion_handler)}, io_work{asio::make_work_guard(
+                                                                               io_context.get_executor())},
+              run_timer{io_context}, is_open{false}, executing{false} {
+
+            int timer_count = 25;
+            internal_timers.reserve(timer_count);
+            for (int timer_index = 0; timer_index < timer_count; ++timer_index) {
+                internal_timers.emplace_back(io_context);
+            }
+        }
+
+        internal_state(internal_state const &) = delete;
+        internal_state(internal_state &&) = delete;
+        internal_state &operator=(internal_state const &) = delete;
+        internal_state &operator=(internal_state &&) = delete;
+
+        ~internal_state() {
+            DEV_NEW_ASSERT(!executing);
+            executing = true;
+            BOOST_SCOPE_EXIT_ALL(&) { executing = false; };
+
+            io_work.reset();
+            try {
+                user_completion_handler(user_completion_error);
+            } catch (...) {
+                try {
+                    io_context.post(asio::bind_executor(get_executor(),
+                                                        [e = std::current_exception()] { std::rethrow_exception(e); }));
+                } catch (...) {
+                    // Not much we can do here if post() failed.
+                }
+            }
+        }
+
+        void start_many_waits(std::chrono::steady_clock::duration run_duration) {
+            DEV_NEW_ASSERT(user_resource);
+            DEV_NEW_ASSERT(!executing);
+            executing = true;
+            BOOST_SCOPE_EXIT_ALL(&) { executing = false; };
+
+            std::random_device rd;
+            std::mt19937 gen(rd());
+            std::uniform_int_distribution<int> one_wait_distribution(0, 100);
+
+            run_timer.expires_after(run_duration);
+            run_timer.async_wait(
+                asio::bind_executor(get_executor(), [this, self = this->shared_from_this()](error_code ec) {
+                    DEV_NEW_ASSERT(!executing);
+                    executing = true;
+                    BOOST_SCOPE_EXIT_ALL(&) { executing = false; };
+
+                    close(ec);
+                }));
+
+            for (auto timer_index : boost::irange<std::size_t>(0, internal_timers.size())) {
+                start_one_wait(timer_index, std::chrono::microseconds(one_wait_distribution(gen)));
+            }
+            is_open = true;
+        }
+
+        void close(error_code ec) {
+            if (!is_open) {
+                return;
+            }
+            user_completion_error = ec;
+            is_open = false;
+            run_timer.cancel();
+            for (auto &timer : internal_timers) {
+                timer.cancel();
+            }
+        }
+
+        void start_one_wait(std::size_t timer_index, std::chrono::steady_clock::duration one_wait) {
+            auto &timer = internal_timers[timer_index];
+            timer.expires_after(one_wait);
+            timer.async_wait(asio::bind_executor(
+                get_executor(), [this, timer_index, one_wait, self = this->shared_from_this()](error_code ec) {
+                    DEV_NEW_ASSERT(user_resource);
+                    DEV_NEW_ASSERT(!executing);
+                    executing = true;
+                    BOOST_SCOPE_EXIT_ALL(&) { executing = false; };
+
+                    completed_waits.fetch_add(1, std::memory_order_relaxed);
+                    std::vector<char> buffer(64 + 16 * timer_index);
+                    if (is_open && !ec) {
+                        start_one_wait(timer_index, one_wait);
+                    } else if (ec && ec != asio::error::operation_aborted) {
+                        close(ec);
+                    }
+                }));
+        }
+
+#if BOOST_COMP_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-local-typedefs"
+#endif
+        using executor_type = asio::associated_executor_t<completion_handler_type, asio::io_context::executor_type>;
+#if BOOST_COMP_CLANG
+#pragma clang diagnostic pop
+#endif
+        executor_type get_executor() const noexcept {
+            return asio::get_associated_executor(user_completion_handler, io_context.get_executor());
+        }
+
+        asio::io_context &io_context;
+        bool &user_resource;
+        completion_handler_type user_completion_handler;
+        error_code user_completion_error;
+        asio::executor_work_guard<asio::io_context::executor_type> io_work;
+
+        asio::steady_timer run_timer;
+        std::vector<asio::steady_timer> internal_timers;
+        bool is_open;
+        std::atomic_bool executing;
+    };
+
+    completion_type completion(token);
+    std::make_shared<internal_state>(io_context, user_resource, std::move(completion.completion_handler))
+        ->start_many_waits(run_duration);
+    return completion.result.get();
+}
+
+// Runs one composed operation per strand and returns the number of completed timer waits.
+std::uint64_t run_operations(unsigned thread_count, std::chrono::steady_clock::duration run_duration) {
+    completed_waits = 0;
+    try {
+        // The user resources outlive the io_context, which may complete the operations when destroyed.
+        std::vector<std::unique_ptr<bool>> user_resources;
+        user_resources.reserve(thread_count);
+        asio::io_context io_context;
+        for (unsigned i = 0; i < thread_count; ++i) {
+            auto &user_resource = user_resources.emplace_back(std::make_unique<bool>(true));
+            // See asio_post_loop_mt.cpp for why the io_context strand is used.
+            asio::io_context::strand strand(io_context);
+            async_many_timers(io_context, *user_resource, run_duration,
+                              asio::bind_executor(strand, [&user_resource](error_code const &error) {
+                                  *user_resource = false;
+                                  user_resource.reset();
+                                  if (error) {
+                                      dev_new::run_no_error_testing(
+                                          [&] { std::cout << "Timers error: " << error.message() << std::endl; });
+                                  }
+                              }));
+        }
+        error_testing::run_io_context(io_context, thread_count);
+    } catch (std::exception const &e) {
+        dev_new::run_no_error_testing([&] { std::cout << "Run error: " << e.what() << std::endl; });
+    }
+    return completed_waits.load();
+}
+
+// Runs the operations with an error raised after `error_countdown` error points.
+std::uint64_t run_operations_error_testing(unsigned thread_count, std::uint64_t error_countdown) {
+    dev_new::set_error_countdown(error_countdown);
+    auto waits = run_operations(thread_count, std::chrono::milliseconds(20));
+    dev_new::pause_error_testing();
+    return waits;
+}
+
+} // namespace
+
+int main() {
+    bool no_leaks = true;
+    for (unsigned thread_count : {1U, 2U, 4U, 8U}) {
+        for (std::uint64_t error_countdown = 1; error_countdown <= 1024; error_countdown *= 2) {
+            no_leaks &= error_testing::measure_scaling("error testing", thread_count, [=] {
+                return run_operations_error_testing(thread_count, error_countdown);
+            });
+        }
+        no_leaks &= error_testing::measure_scaling("no errors", thread_count, [thread_count] {
+            return run_operations(thread_count, std::chrono::milliseconds(500));
+        });
+    }
+    return no_leaks ? 0 : 1;
+}
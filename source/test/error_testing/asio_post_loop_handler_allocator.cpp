@@ -0,0 +1,42 @@
+// Error testing of a loop (chain) of asio::io_context::post() calls using the dev_new handler allocator.
+#include "dev_new.hpp"
+#include "dev_new_asio.hpp"
+#include "run_loop.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <vector>
+
+namespace asio = boost::asio;
+
+namespace {
+
+using buffer_t = std::vector<char>;
+
+void posted_func(asio::io_context &io_context, unsigned count, buffer_t buffer) {
+    dev_new::run_no_error_testing([&] { std::cout << "posted_func: " << count << std::endl; });
+    if (count != 0) {
+        asio::post(io_context,
+                   dev_new::bind_handler_allocator([&io_context, count, buffer = std::move(buffer)]() mutable {
+                       posted_func(io_context, count - 1, std::move(buffer));
+                   }));
+    }
+}
+
+} // namespace
+
+int main() {
+    error_testing::run_loop([] {
+        asio::io_context io_context;
+        asio::post(io_context,
+                   dev_new::bind_handler_allocator([&io_context, count = 3, buffer = buffer_t(10)]() mutable {
+                       posted_func(io_context, count, std::move(buffer));
+                   }));
+        io_context.run();
+    });
+
+    auto counters = dev_new::handler_allocation_counters();
+    std::cout << "Handler allocations: " << counters.allocations << " Recycled: " << counters.recycled_allocations
+              << " Released blocks: " << counters.released_blocks << std::endl;
+    return 0;
+}
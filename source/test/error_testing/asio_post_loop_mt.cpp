@@ -0,0 +1,72 @@
+// Multi-threaded error testing of loops (chains) of asio::post() calls.
+// One chain runs on each strand of an io_context that is run by several threads. For each thread count, short chains
+// are run under error testing and long chains are run without errors, reporting the throughput, the allocator lock
+// contention and whether the live allocations returned to their initial count.
+#include "dev_new.hpp"
+#include "run_loop.hpp"
+
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/post.hpp>
+#include <vector>
+
+namespace asio = boost::asio;
+
+namespace {
+
+// The io_context strand is used instead of asio::strand<>, which isn't exception safe in all asio versions: a failed
+// allocation of the shared strand implementation destroys an implementation whose mutex has not been created and a
+// handler exception makes the strand repost its invoker from a destructor, terminating the program if the allocation
+// fails.
+using strand_type = asio::io_context::strand;
+
+std::atomic<std::uint64_t> posted_calls{0};
+
+void posted_func(strand_type const &strand, unsigned count) {
+    posted_calls.fetch_add(1, std::memory_order_relaxed);
+    std::vector<char> buffer(64 + count % 256);
+    if (count != 0) {
+        asio::post(strand, [&strand, count] { posted_func(strand, count - 1); });
+    }
+}
+
+void run_chains(unsigned thread_count, unsigned count) {
+    asio::io_context io_context;
+    std::vector<strand_type> strands;
+    strands.reserve(thread_count);
+    for (unsigned i = 0; i < thread_count; ++i) {
+        strands.emplace_back(io_context);
+    }
+    for (auto const &strand : strands) {
+        asio::post(strand, [&strand, count] { posted_func(strand, count); });
+    }
+    error_testing::run_io_context(io_context, thread_count);
+}
+
+// Returns the number of posted calls.
+std::uint64_t run_chains_error_testing(unsigned thread_count) {
+    posted_calls = 0;
+    error_testing::run_loop([thread_count] { run_chains(thread_count, 3); });
+    dev_new::pause_error_testing();
+    return posted_calls.load();
+}
+
+std::uint64_t run_chains_no_errors(unsigned thread_count) {
+    posted_calls = 0;
+    run_chains(thread_count, 20000);
+    return posted_calls.load();
+}
+
+} // namespace
+
+int main() {
+    bool no_leaks = true;
+    for (unsigned thread_count : {1U, 2U, 4U, 8U}) {
+        no_leaks &= error_testing::measure_scaling("error testing", thread_count,
+                                                   [thread_count] { return run_chains_error_testing(thread_count); });
+        no_leaks &= error_testing::measure_scaling("no errors", thread_count,
+                                                   [thread_count] { return run_chains_no_errors(thread_count); });
+    }
+    return no_leaks ? 0 : 1;
+}
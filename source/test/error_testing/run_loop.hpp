@@ -3,16 +3,142 @@
 
 #include "dev_new.hpp"
 
+#include <algorithm>
 #include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 namespace asio = boost::asio;
 
 namespace error_testing {
 
+/// Timing of a run_loop() iteration.
+struct iteration_timing {
+    std::uint64_t error_countdown;
+    std::uint64_t nanoseconds;
+    /// Time stamp counter ticks spent in the allocator operations (see self_profile()).
+    std::uint64_t allocator_ticks;
+    bool error;
+};
+
+/// Returns the ticks spent in the allocator operations since self profiling was first enabled.
+inline std::uint64_t allocator_ticks() noexcept {
+    auto profile = dev_new::self_profile();
+    std::uint64_t ticks = 0;
+    for (auto const &operation : profile.operations) {
+        ticks += operation.total;
+    }
+    return ticks;
+}
+
+/// Writes the timing report of a run_loop() as a single line JSON object.
+inline void write_timing_report(std::FILE *file, std::vector<iteration_timing> &iterations,
+                                std::uint64_t loop_nanoseconds, std::size_t max_slowest = 5) {
+    auto ticks_per_nanosecond = dev_new::self_profile().ticks_per_nanosecond;
+    auto seconds = [](std::uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1e9; };
+    auto allocator_seconds = [&](std::uint64_t ticks) {
+        return static_cast<double>(ticks) / ticks_per_nanosecond / 1e9;
+    };
+    std::uint64_t errors = 0;
+    std::uint64_t iteration_nanoseconds = 0;
+    std::uint64_t ticks = 0;
+    for (auto const &iteration : iterations) {
+        errors += iteration.error ? 1 : 0;
+        iteration_nanoseconds += iteration.nanoseconds;
+        ticks += iteration.allocator_ticks;
+    }
+    auto total = seconds(iteration_nanoseconds);
+    auto allocator = std::min(allocator_seconds(ticks), total);
+
+    auto slowest = std::min(max_slowest, iterations.size());
+    std::partial_sort(iterations.begin(), iterations.begin() + static_cast<std::ptrdiff_t>(slowest), iterations.end(),
+                      [](auto const &a, auto const &b) { return a.nanoseconds > b.nanoseconds; });
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fprintf(file,
+                 "{\"iterations\": %zu, \"errors\": %" PRIu64 ", \"loop_seconds\": %.6f, \"iteration_seconds\": %.6f,"
+                 " \"iterations_per_second\": %.1f, \"allocator_seconds\": %.6f, \"other_seconds\": %.6f,"
+                 " \"allocator_fraction\": %.4f, \"total_allocations\": %" PRIu64 ", \"live_allocations\": %" PRIu64
+                 ", \"slowest\": [",
+                 iterations.size(), errors, seconds(loop_nanoseconds), total,
+                 total > 0 ? static_cast<double>(iterations.size()) / total : 0.0, allocator, total - allocator,
+                 total > 0 ? allocator / total : 0.0, dev_new::total_allocations(), dev_new::live_allocations());
+    for (std::size_t i = 0; i != slowest; ++i) {
+        auto const &iteration = iterations.at(i);
+        std::fprintf(file,
+                     "%s{\"error_countdown\": %" PRIu64 ", \"seconds\": %.6f, \"allocator_seconds\": %.6f,"
+                     " \"error\": %s}",
+                     i == 0 ? "" : ", ", iteration.error_countdown, seconds(iteration.nanoseconds),
+                     allocator_seconds(iteration.allocator_ticks), iteration.error ? "true" : "false");
+    }
+    std::fprintf(file, "]}\n");
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fflush(file);
+}
+
+/// Error testing run loop in timing mode (see run_loop()).
+template <typename F> void run_timed_loop(F const &f, char const *report_path) {
+    using clock = std::chrono::steady_clock;
+    auto nanoseconds = [](clock::duration duration) {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    };
+    dev_new::pause_error_testing();
+    bool const self_profiling = dev_new::is_self_profiling();
+    dev_new::set_self_profiling(true);
+    std::vector<iteration_timing> iterations;
+
+    auto loop_start = clock::now();
+    std::uint64_t error_countdown = 1;
+    bool retry = true;
+    while (retry) {
+        iteration_timing iteration{error_countdown, 0, allocator_ticks(), false};
+        dev_new::set_error_countdown(error_countdown);
+        auto start = clock::now();
+        try {
+            f();
+        } catch (std::exception & /*unused*/) {
+            iteration.error = true;
+        }
+        auto end = clock::now();
+        dev_new::pause_error_testing();
+        iteration.nanoseconds = nanoseconds(end - start);
+        iteration.allocator_ticks = allocator_ticks() - iteration.allocator_ticks;
+        iterations.push_back(iteration);
+        retry = 0 == dev_new::get_error_countdown();
+        ++error_countdown;
+    }
+    auto loop_nanoseconds = nanoseconds(clock::now() - loop_start);
+
+    bool const to_stdout = *report_path == '\0' || std::strcmp(report_path, "-") == 0;
+    std::FILE *file = to_stdout ? stdout : std::fopen(report_path, "a");
+    if (file == nullptr) {
+        std::perror(report_path);
+        file = stdout;
+    }
+    write_timing_report(file, iterations, loop_nanoseconds);
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    dev_new::set_self_profiling(self_profiling);
+}
+
 /// Error testing run loop.
 /// It calls the given function as long as the error countdown leads to an error being raised.
+/// When the ERROR_TESTING_TIMING environment variable is set, the loop runs in timing mode: the iterations aren't
+/// logged, they are timed, and the loop appends a JSON line to the file named by the variable (the standard output if
+/// it is empty or "-") with the iterations per second, the split of the time between the allocator operations (as
+/// measured by self profiling) and the rest, and the slowest iterations.
 template <typename F> void run_loop(F const &f) {
+    if (char const *report_path = std::getenv("ERROR_TESTING_TIMING")) {
+        run_timed_loop(f, report_path);
+        return;
+    }
     std::uint64_t error_countdown = 1;
     bool retry = true;
     while (retry) {
@@ -50,6 +176,50 @@ inline void run_io_context(asio::io_context &io_context) {
     }
 }
 
+/// Runs an io_context on the calling thread and on `thread_count - 1` other threads (see run_io_context()).
+/// The other threads are created with error testing paused.
+inline void run_io_context(asio::io_context &io_context, unsigned thread_count) {
+    std::vector<std::thread> threads;
+    bool const error_testing = dev_new::is_error_testing();
+    dev_new::pause_error_testing();
+    threads.reserve(thread_count);
+    for (unsigned i = 1; i < thread_count; ++i) {
+        threads.emplace_back([&io_context] { run_io_context(io_context); });
+    }
+    if (error_testing) {
+        dev_new::resume_error_testing();
+    }
+    run_io_context(io_context);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+/// Scaling measurement of a multi-threaded run.
+/// It calls the given function, which returns the number of operations it completed, and prints the throughput, the
+/// allocator lock contention and the live allocations left by the call. Returns false if the call leaked allocations.
+template <typename F> bool measure_scaling(char const *name, unsigned thread_count, F const &f) {
+    auto live_before = dev_new::live_allocations();
+    auto lock_before = dev_new::lock_statistics();
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t operations = f();
+    auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto lock_after = dev_new::lock_statistics();
+    auto live_after = dev_new::live_allocations();
+
+    auto contended = lock_after.contended_acquisitions - lock_before.contended_acquisitions;
+    auto wait_ms = static_cast<double>(lock_after.wait_nanoseconds - lock_before.wait_nanoseconds) / 1e6;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::printf("[%s] threads: %2u operations: %8" PRIu64 " time: %8.3fs operations/s: %10.0f"
+                " lock acquisitions: %9" PRIu64 " contended: %8" PRIu64 " lock wait: %9.3fms"
+                " live allocations: %" PRIu64 " -> %" PRIu64 " (%s)\n",
+                name, thread_count, operations, duration, static_cast<double>(operations) / duration,
+                lock_after.acquisitions - lock_before.acquisitions, contended, wait_ms, live_before, live_after,
+                live_after == live_before ? "ok" : "LEAK");
+    std::fflush(stdout);
+    return live_after == live_before;
+}
+
 } // namespace error_testing
 
 #endif
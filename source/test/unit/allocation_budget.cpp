@@ -0,0 +1,36 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <memory>
+#include <vector>
+
+namespace asio = boost::asio;
+
+TEST_CASE("thread counters", "[allocation_budget]") {
+    auto before = dev_new::thread_allocation_counters();
+    {
+        auto i = std::make_unique<std::uint32_t>(0);
+        auto after = dev_new::thread_allocation_counters();
+        CHECK(after.allocations == before.allocations + 1);
+        CHECK(after.allocated_size == before.allocated_size + sizeof(std::uint32_t));
+    }
+    auto after = dev_new::thread_allocation_counters();
+    CHECK(after.deallocations == before.deallocations + 1);
+    CHECK(after.deallocated_size == before.deallocated_size + sizeof(std::uint32_t));
+}
+
+TEST_CASE("allocation budget", "[allocation_budget]") {
+    DEV_NEW_REQUIRE_MAX_ALLOCATIONS(std::make_unique<int>(1), 1);
+    DEV_NEW_REQUIRE_MAX_ALLOCATIONS(std::vector<char>{}, 0);
+    DEV_NEW_REQUIRE_MAX_BYTES(std::vector<char>(100), 100);
+    DEV_NEW_CHECK_MAX_BYTES(std::vector<std::uint64_t>(10), 10 * sizeof(std::uint64_t));
+}
+
+TEST_CASE("posting a moved handler allocates at most once", "[allocation_budget]") {
+    asio::io_context io_context;
+    std::vector<char> buffer(10);
+    DEV_NEW_CHECK_MAX_ALLOCATIONS(asio::post(io_context, [buffer = std::move(buffer)] { (void)buffer; }), 1);
+    io_context.run();
+}
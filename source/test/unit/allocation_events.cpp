@@ -0,0 +1,79 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+// The test allocations have a size that the test framework doesn't use.
+std::size_t const event_size = 12345;
+
+struct event_counts {
+    std::array<std::atomic<std::uint64_t>, 4> events;
+    std::atomic<std::uint64_t> peaks;
+};
+
+void count_events(dev_new::allocation_event const &event, void *context) {
+    auto &counts = *static_cast<event_counts *>(context);
+    if (event.type == dev_new::allocation_event_type::peak_reached) {
+        counts.peaks.fetch_add(1, std::memory_order_relaxed);
+    } else if (event.size == event_size) {
+        counts.events.at(static_cast<std::size_t>(event.type)).fetch_add(1, std::memory_order_relaxed);
+        // The allocations of an observer don't publish events.
+        dev_new::deallocate(dev_new::allocate(event_size));
+    }
+}
+
+std::uint64_t count(event_counts const &counts, dev_new::allocation_event_type type) {
+    return counts.events.at(static_cast<std::size_t>(type)).load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+TEST_CASE("allocation events", "[allocation_events]") {
+    static event_counts counts{};
+    auto id = dev_new::register_observer(count_events, &counts);
+    REQUIRE(id != 0);
+
+    std::array<void *, 3> ptrs{};
+    for (auto &ptr : ptrs) {
+        ptr = dev_new::allocate(event_size);
+    }
+    for (auto ptr : ptrs) {
+        dev_new::deallocate(ptr);
+    }
+    // An allocation above the peak.
+    dev_new::deallocate(dev_new::allocate(4 * 1024 * 1024));
+    dev_new::set_error_countdown(1);
+    DEV_NEW_CHECK(dev_new::allocate(event_size, std::nothrow) == nullptr);
+    DEV_NEW_END_TEST();
+
+    dev_new::flush_allocation_events();
+    CHECK(count(counts, dev_new::allocation_event_type::allocate) == ptrs.size());
+    CHECK(count(counts, dev_new::allocation_event_type::deallocate) == ptrs.size());
+    CHECK(count(counts, dev_new::allocation_event_type::error_injected) == 1);
+    CHECK(counts.peaks.load() != 0);
+
+    auto statistics = dev_new::allocation_event_statistics();
+    CHECK(statistics.published_events >= 2 * ptrs.size() + 1);
+    CHECK(statistics.delivered_events + statistics.dropped_events <= statistics.published_events);
+
+    // Once unregistered, the observer isn't called.
+    dev_new::unregister_observer(id);
+    dev_new::deallocate(dev_new::allocate(event_size));
+    CHECK(count(counts, dev_new::allocation_event_type::allocate) == ptrs.size());
+}
+
+TEST_CASE("allocation events of other threads", "[allocation_events]") {
+    static event_counts counts{};
+    auto id = dev_new::register_observer(count_events, &counts);
+    REQUIRE(id != 0);
+    std::thread([] { dev_new::deallocate(dev_new::allocate(event_size)); }).join();
+    dev_new::flush_allocation_events();
+    CHECK(count(counts, dev_new::allocation_event_type::allocate) == 1);
+    CHECK(count(counts, dev_new::allocation_event_type::deallocate) == 1);
+    dev_new::unregister_observer(id);
+}
@@ -0,0 +1,39 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct order_book_tag {};
+struct sessions_tag {};
+
+} // namespace
+
+TEST_CASE("tagged allocator statistics", "[allocator]") {
+    using order_book = std::vector<double, dev_new::allocator<double, order_book_tag>>;
+    using sessions = std::map<int, int, std::less<>, dev_new::allocator<std::pair<int const, int>, sessions_tag>>;
+    {
+        order_book orders(100);
+        sessions s;
+        for (int i = 0; i < 10; ++i) {
+            s.emplace(i, i);
+        }
+        dev_new::check_allocation(orders.data());
+
+        auto order_book_stats = dev_new::stats<order_book_tag>();
+        CHECK(order_book_stats.live_allocations == 1);
+        CHECK(order_book_stats.allocated_size == 100 * sizeof(double));
+        auto sessions_stats = dev_new::stats<sessions_tag>();
+        CHECK(sessions_stats.live_allocations == 10);
+        CHECK(sessions_stats.total_allocations == 10);
+    }
+
+    auto order_book_stats = dev_new::stats<order_book_tag>();
+    CHECK(order_book_stats.live_allocations == 0);
+    CHECK(order_book_stats.allocated_size == 0);
+    CHECK(order_book_stats.max_allocated_size == 100 * sizeof(double));
+    CHECK(dev_new::stats<sessions_tag>().allocated_size == 0);
+}
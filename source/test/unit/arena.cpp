@@ -0,0 +1,155 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace asio = boost::asio;
+
+// The assertions are made outside the arena scopes: the allocations made by Catch in a scope would be counted in it
+// and would keep its region once it ends.
+
+TEST_CASE("arena allocations", "[arena]") {
+    auto live_before = dev_new::live_allocations();
+    auto allocated_before = dev_new::allocated_size();
+    auto leftovers_before = dev_new::arena_leftover_statistics();
+    std::uint64_t live_in_scope = 0;
+    std::uint64_t allocated_in_scope = 0;
+    std::uint64_t live_after_delete = 0;
+    bool checked = false;
+    dev_new::arena_counters counters{};
+    {
+        dev_new::arena_scope scope(1024);
+        auto first = std::make_unique<int>(1);
+        void *second = ::operator new(100);
+        std::vector<char> third(2000);
+        checked = dev_new::check_allocation(first.get(), std::nothrow) &&
+                  dev_new::check_allocation(second, std::nothrow) &&
+                  dev_new::check_allocation(third.data(), std::nothrow);
+        live_in_scope = dev_new::live_allocations();
+        allocated_in_scope = dev_new::allocated_size();
+        first.reset();
+        live_after_delete = dev_new::live_allocations();
+        ::operator delete(second);
+        counters = scope.statistics();
+    }
+
+    CHECK(checked);
+    CHECK(live_in_scope == live_before + 3);
+    CHECK(allocated_in_scope == allocated_before + sizeof(int) + 100 + 2000);
+    CHECK(live_after_delete == live_before + 2);
+    CHECK(counters.allocations == 3);
+    CHECK(counters.allocated_size == sizeof(int) + 100 + 2000);
+    // The 2000 bytes allocation didn't fit in the first block.
+    CHECK(counters.blocks == 2);
+    CHECK(counters.reserved_size >= 1024 + 2000);
+    CHECK(dev_new::live_allocations() == live_before);
+    CHECK(dev_new::allocated_size() == allocated_before);
+    CHECK(dev_new::arena_leftover_statistics().scopes == leftovers_before.scopes);
+}
+
+TEST_CASE("arena scopes nest", "[arena]") {
+    dev_new::arena_counters outer_counters{};
+    dev_new::arena_counters inner_counters{};
+    {
+        dev_new::arena_scope outer;
+        void *outer_first = dev_new::allocate(100);
+        {
+            dev_new::arena_scope inner;
+            void *inner_first = dev_new::allocate(100);
+            dev_new::deallocate(dev_new::allocate(10));
+            dev_new::deallocate(inner_first);
+            inner_counters = inner.statistics();
+        }
+        dev_new::deallocate(dev_new::allocate(10));
+        dev_new::deallocate(outer_first);
+        outer_counters = outer.statistics();
+    }
+    CHECK(inner_counters.allocations == 2);
+    CHECK(outer_counters.allocations == 2);
+    CHECK(outer_counters.allocated_size == 110);
+}
+
+TEST_CASE("arena scopes ending with live allocations", "[arena]") {
+    auto live_before = dev_new::live_allocations();
+    auto leftovers_before = dev_new::arena_leftover_statistics();
+    void *kept = nullptr;
+    {
+        dev_new::arena_scope scope;
+        kept = dev_new::allocate(100);
+        dev_new::deallocate(dev_new::allocate(50));
+    }
+    auto leftovers = dev_new::arena_leftover_statistics();
+    CHECK(leftovers.scopes == leftovers_before.scopes + 1);
+    CHECK(leftovers.allocations == leftovers_before.allocations + 1);
+    CHECK(leftovers.allocated_size == leftovers_before.allocated_size + 100);
+    CHECK(leftovers.kept_regions == leftovers_before.kept_regions + 1);
+
+    // The region is kept: the allocation can still be used.
+    CHECK(dev_new::check_allocation(kept, std::nothrow));
+    std::memset(kept, 0, 100);
+    CHECK(dev_new::live_allocations() == live_before + 1);
+    dev_new::deallocate(kept);
+    CHECK(dev_new::arena_leftover_statistics().kept_regions == leftovers_before.kept_regions);
+    CHECK(dev_new::live_allocations() == live_before);
+}
+
+TEST_CASE("arena scopes with asio handlers", "[arena]") {
+    auto live_before = dev_new::live_allocations();
+    auto leftovers_before = dev_new::arena_leftover_statistics();
+    dev_new::arena_leftover_counters leftovers_in_run{};
+    int calls = 0;
+    {
+        asio::io_context io_context;
+        asio::post(io_context, [&] {
+            {
+                dev_new::arena_scope scope;
+                // The handler is larger than the one running, whose memory asio has already recycled, so that its
+                // memory is allocated in the region. It is still queued at the end of the scope.
+                asio::post(io_context, [&calls, padding = std::array<char, 256>{}] {
+                    (void)padding;
+                    ++calls;
+                });
+            }
+            leftovers_in_run = dev_new::arena_leftover_statistics();
+        });
+        io_context.run();
+        // The memory of the handler has been recycled by the io_context: it is reused by the handlers posted after
+        // the scope.
+        io_context.restart();
+        asio::post(io_context, [&calls, padding = std::array<char, 256>{}] {
+            (void)padding;
+            ++calls;
+        });
+        io_context.run();
+    }
+    CHECK(calls == 2);
+    CHECK(leftovers_in_run.scopes == leftovers_before.scopes + 1);
+    CHECK(leftovers_in_run.kept_regions == leftovers_before.kept_regions + 1);
+    CHECK(dev_new::arena_leftover_statistics().kept_regions == leftovers_before.kept_regions);
+    CHECK(dev_new::live_allocations() == live_before);
+}
+
+TEST_CASE("arena allocations are error points", "[arena]") {
+    auto live_before = dev_new::live_allocations();
+    bool failed = false;
+    {
+        dev_new::arena_scope scope;
+        dev_new::set_error_countdown(2);
+        void *first = nullptr;
+        try {
+            first = dev_new::allocate(sizeof(int));
+            dev_new::deallocate(dev_new::allocate(sizeof(int)));
+        } catch (std::bad_alloc const &) {
+            failed = true;
+        }
+        dev_new::deallocate(first);
+        dev_new::pause_error_testing();
+    }
+    CHECK(failed);
+    CHECK(dev_new::live_allocations() == live_before);
+}
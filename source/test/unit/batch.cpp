@@ -0,0 +1,33 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <array>
+
+TEST_CASE("batch allocation", "[batch]") {
+    std::array<void *, 100> ptrs{};
+    auto live_before = dev_new::live_allocations();
+    auto allocated_before = dev_new::allocated_size();
+    auto counters = dev_new::catch_detail::measure_allocations(
+        [&] { dev_new::allocate_batch(32, ptrs.size(), ptrs.data()); });
+    CHECK(counters.allocations == ptrs.size());
+    CHECK(dev_new::live_allocations() == live_before + ptrs.size());
+    CHECK(dev_new::allocated_size() == allocated_before + 32 * ptrs.size());
+    for (auto ptr : ptrs) {
+        dev_new::check_allocation(ptr);
+    }
+
+    dev_new::deallocate_batch(ptrs.data(), ptrs.size());
+    CHECK(dev_new::live_allocations() == live_before);
+    CHECK(dev_new::allocated_size() == allocated_before);
+}
+
+TEST_CASE("batch allocation error points", "[batch]") {
+    static std::array<void *, 5> ptrs{};
+    auto live_before = dev_new::live_allocations();
+    dev_new::set_error_countdown(3);
+    DEV_NEW_CHECK_THROWS_AS(dev_new::allocate_batch(16, ptrs.size(), ptrs.data()), std::bad_alloc);
+    DEV_NEW_CHECK(dev_new::get_error_countdown() == 0);
+    DEV_NEW_CHECK(!dev_new::allocate_batch(16, ptrs.size(), ptrs.data(), std::nothrow));
+    DEV_NEW_END_TEST();
+    CHECK(dev_new::live_allocations() == live_before);
+}
@@ -0,0 +1,51 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+dev_new::category_statistics find_category(char const *name) {
+    auto statistics = dev_new::categories_statistics();
+    auto it = std::find_if(statistics.begin(), statistics.end(),
+                           [&](auto const &category) { return std::strcmp(category.name, name) == 0; });
+    REQUIRE(it != statistics.end());
+    return *it;
+}
+
+} // namespace
+
+TEST_CASE("category scopes", "[category]") {
+    std::unique_ptr<char[]> parser_buffer;
+    {
+        dev_new::category_scope parser{"test_parser"};
+        parser_buffer = std::make_unique<char[]>(100);
+        {
+            dev_new::category_scope lexer{"test_lexer"};
+            std::vector<char> tokens(50);
+        }
+        std::vector<char> temporary(10);
+    }
+
+    auto parser = find_category("test_parser");
+    CHECK(parser.total_allocations == 2);
+    CHECK(parser.total_deallocations == 1);
+    CHECK(parser.allocated_size == 100);
+    CHECK(parser.max_allocated_size == 110);
+    CHECK(parser.total_allocated_size == 110);
+
+    auto lexer = find_category("test_lexer");
+    CHECK(lexer.total_allocations == 1);
+    CHECK(lexer.allocated_size == 0);
+    CHECK(lexer.max_allocated_size == 50);
+
+    // Freed from another thread, outside any scope.
+    std::thread([&parser_buffer] { parser_buffer.reset(); }).join();
+    parser = find_category("test_parser");
+    CHECK(parser.total_deallocations == 2);
+    CHECK(parser.allocated_size == 0);
+}
@@ -2,8 +2,50 @@
 #define DEV_NEW_CATCH_HPP
 
 #include "dev_new.hpp"
+#include <algorithm>
 #include <boost/scope_exit.hpp>
 #include <catch2/catch.hpp>
+#include <sstream>
+#include <string>
+
+namespace dev_new {
+namespace catch_detail {
+
+/// Runs a function and returns the allocations it made on the current thread.
+template <typename F> allocation_counters measure_allocations(F const &f) {
+    auto before = thread_allocation_counters();
+    f();
+    auto after = thread_allocation_counters();
+    return allocation_counters{after.allocations - before.allocations, after.deallocations - before.deallocations,
+                               after.allocated_size - before.allocated_size,
+                               after.deallocated_size - before.deallocated_size, after.max_allocation_size};
+}
+
+/// Runs a function with error testing paused, restoring the error testing state afterwards.
+template <typename F> void run_paused_error_testing(F const &f) {
+    bool const error_testing = is_error_testing();
+    pause_error_testing();
+    BOOST_SCOPE_EXIT_ALL(&) {
+        if (error_testing) {
+            resume_error_testing();
+        }
+    };
+    f();
+}
+
+/// Describes the allocations made by an expression checked against an allocation budget.
+inline std::string describe_allocations(char const *expression, allocation_counters const &counters) {
+    std::ostringstream out;
+    out << "allocations made by: " << expression << "\n"
+        << "  allocations: " << counters.allocations << " (" << counters.allocated_size << " bytes)\n"
+        << "  deallocations: " << counters.deallocations << " (" << counters.deallocated_size << " bytes)\n"
+        << "  live after: " << counters.allocations - std::min(counters.allocations, counters.deallocations)
+        << " (thread's largest allocation so far: " << counters.max_allocation_size << " bytes)";
+    return out.str();
+}
+
+} // namespace catch_detail
+} // namespace dev_new
 
 #define DEV_NEW_END_TEST() dev_new::pause_error_testing();
 
@@ -15,4 +57,30 @@
 #define DEV_NEW_CHECK_THROWS_AS(expression, exceptionType)                                                             \
     ::dev_new::run_no_error_testing([] { CHECK_THROWS_AS(DEV_NEW_RUN_ERROR_TESTING(expression), exceptionType); })
 
+/// Allocation budget assertions.
+/// The expression is evaluated once and the allocations it made on the current thread are checked against the budget.
+/// On failure, the assertion reports a breakdown of the allocations and deallocations made by the expression.
+// \{
+#define DEV_NEW_ALLOCATION_BUDGET_IMPL(assertion, expression, counter, budget)                                         \
+    do {                                                                                                               \
+        auto const dev_new_counters = ::dev_new::catch_detail::measure_allocations([&] { (void)(expression); });       \
+        ::dev_new::catch_detail::run_paused_error_testing([&] {                                                        \
+            INFO(::dev_new::catch_detail::describe_allocations(#expression, dev_new_counters));                        \
+            assertion(dev_new_counters.counter <= static_cast<std::uint64_t>(budget));                                 \
+        });                                                                                                            \
+    } while (false)
+
+#define DEV_NEW_REQUIRE_MAX_ALLOCATIONS(expression, max_allocations)                                                   \
+    DEV_NEW_ALLOCATION_BUDGET_IMPL(REQUIRE, expression, allocations, max_allocations)
+
+#define DEV_NEW_CHECK_MAX_ALLOCATIONS(expression, max_allocations)                                                     \
+    DEV_NEW_ALLOCATION_BUDGET_IMPL(CHECK, expression, allocations, max_allocations)
+
+#define DEV_NEW_REQUIRE_MAX_BYTES(expression, max_bytes)                                                               \
+    DEV_NEW_ALLOCATION_BUDGET_IMPL(REQUIRE, expression, allocated_size, max_bytes)
+
+#define DEV_NEW_CHECK_MAX_BYTES(expression, max_bytes)                                                                 \
+    DEV_NEW_ALLOCATION_BUDGET_IMPL(CHECK, expression, allocated_size, max_bytes)
+// \}
+
 #endif
@@ -10,3 +10,12 @@ TEST_CASE("basic test", "[error_point]") {
     DEV_NEW_CHECK(dev_new::get_error_countdown() == 0);
     DEV_NEW_END_TEST();
 }
+
+TEST_CASE("nothrow test", "[error_point]") {
+    dev_new::set_error_countdown(2);
+    DEV_NEW_CHECK(dev_new::error_point(std::nothrow));
+    DEV_NEW_CHECK(!dev_new::error_point(std::nothrow));
+    DEV_NEW_CHECK(dev_new::allocate(1, std::nothrow) == nullptr);
+    DEV_NEW_CHECK(dev_new::get_error_countdown() == 0);
+    DEV_NEW_END_TEST();
+}
@@ -0,0 +1,61 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+TEST_CASE("allocation site", "[features]") {
+    auto ptr = std::make_unique<int>(1);
+    auto site = dev_new::allocation_site(ptr.get());
+    CHECK((site != nullptr) == dev_new::features().stack_capture);
+    CHECK(dev_new::allocation_site(nullptr) == nullptr);
+}
+
+TEST_CASE("fill patterns", "[features]") {
+    if (!dev_new::features().fill_patterns) {
+        return;
+    }
+    auto ptr = std::unique_ptr<unsigned char[]>(new unsigned char[32]);
+    CHECK(std::all_of(ptr.get(), ptr.get() + 32, [](unsigned char c) { return c == 0xCDU; }));
+}
+
+// The runtime options are checked by the unit_tests_* tests that run the [runtime_options] tests with DEV_NEW_OPTIONS
+// set (see CMakeLists.txt).
+TEST_CASE("runtime options", "[features][runtime_options]") {
+    char const *options = std::getenv("DEV_NEW_OPTIONS");
+    if (options == nullptr) {
+        CHECK(dev_new::get_runtime_mode() == dev_new::runtime_mode::error_testing);
+        return;
+    }
+    if (std::strcmp(options, "mode=full,large_threshold=65536 error_countdown=7") == 0) {
+        CHECK(dev_new::get_runtime_mode() == dev_new::runtime_mode::full);
+        CHECK(dev_new::get_large_allocation_threshold() == 65536);
+        // The error countdown is only set in error_testing mode (it's reported on stderr).
+        CHECK(dev_new::get_error_countdown() != 7);
+        CHECK_FALSE(dev_new::is_error_testing());
+    }
+    // The invalid options are ignored.
+    if (std::strcmp(options, "mode=bad,large_threshold=12x large_threshold=,error_countdown=-1") == 0) {
+        CHECK(dev_new::get_runtime_mode() == dev_new::runtime_mode::error_testing);
+        CHECK(dev_new::get_large_allocation_threshold() == dev_new::default_large_allocation_threshold);
+        CHECK_FALSE(dev_new::is_error_testing());
+    }
+}
+
+TEST_CASE("passthrough mode", "[features][runtime_options]") {
+    if (dev_new::get_runtime_mode() != dev_new::runtime_mode::passthrough) {
+        return;
+    }
+    // The global operator new only calls malloc: its allocations are not tracked.
+    auto counters_before = dev_new::thread_allocation_counters();
+    auto ptr = std::make_unique<int>(1);
+    CHECK_FALSE(dev_new::check_allocation(ptr.get(), std::nothrow));
+    CHECK(dev_new::thread_allocation_counters().allocations == counters_before.allocations);
+
+    // The allocations of dev_new::allocate() are still tracked.
+    void *tracked = dev_new::allocate(16);
+    CHECK(dev_new::check_allocation(tracked, std::nothrow) == dev_new::features().tracking);
+    dev_new::deallocate(tracked);
+}
@@ -0,0 +1,68 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// Grows a block from 16 to 256 bytes, allocating the new block before freeing the old one.
+void grow_block() {
+    void *ptr = nullptr;
+    for (std::size_t size = 16; size <= 256; size *= 2) {
+        void *grown = dev_new::allocate(size);
+        dev_new::deallocate(ptr);
+        ptr = grown;
+    }
+    dev_new::deallocate(ptr);
+}
+
+std::uint64_t total_growth_steps() {
+    auto sites = dev_new::growth_sites();
+    std::uint64_t steps = 0;
+    for (auto const &site : sites) {
+        steps += site.growth_steps;
+    }
+    return steps;
+}
+
+template <typename F> std::uint64_t count_growth_steps(F const &f) {
+    auto before = total_growth_steps();
+    f();
+    return total_growth_steps() - before;
+}
+
+} // namespace
+
+TEST_CASE("growth steps", "[growth]") {
+    if (!dev_new::features().stack_capture) {
+        return;
+    }
+    grow_block();
+    auto sites = dev_new::growth_sites();
+    CHECK(std::any_of(sites.begin(), sites.end(), [](auto const &site) {
+        return site.growth_steps == 4 && site.copied_size == 16 + 32 + 64 + 128 && site.max_size == 256;
+    }));
+    CHECK(std::is_sorted(sites.begin(), sites.end(),
+                         [](auto const &a, auto const &b) { return a.copied_size > b.copied_size; }));
+
+    // A reserve() removes the growth steps.
+    auto push_back = [](bool reserve) {
+        std::vector<int> values;
+        if (reserve) {
+            values.reserve(4096);
+        }
+        for (int i = 0; i != 4096; ++i) {
+            values.push_back(i);
+        }
+    };
+    CHECK(count_growth_steps([&] { push_back(false); }) >= 10);
+    CHECK(count_growth_steps([&] { push_back(true); }) == 0);
+
+    auto file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    dev_new::print_growth_report(file);
+    CHECK(std::ftell(file) > 0);
+    std::fclose(file);
+}
@@ -0,0 +1,92 @@
+#include "dev_new.hpp"
+#include "dev_new_asio.hpp"
+#include "dev_new_catch.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <cstdint>
+#include <thread>
+
+namespace asio = boost::asio;
+
+namespace {
+
+// Allocates a handler when the thread ends, after the destruction of the handler cache of the thread.
+struct thread_exit_handler {
+    static std::uint64_t recycled_allocations;
+    static std::uint64_t live_allocations;
+
+    thread_exit_handler() = default;
+    ~thread_exit_handler() {
+        auto before = dev_new::handler_allocation_counters();
+        for (int i = 0; i != 2; ++i) {
+            void *ptr = dev_new::allocate_handler(100);
+            dev_new::check_allocation(ptr);
+            dev_new::deallocate_handler(ptr, 100);
+        }
+        auto after = dev_new::handler_allocation_counters();
+        recycled_allocations = after.recycled_allocations - before.recycled_allocations;
+        live_allocations = dev_new::live_allocations();
+    }
+
+    thread_exit_handler(thread_exit_handler const & /*unused*/) = delete;
+    thread_exit_handler(thread_exit_handler && /*unused*/) = delete;
+    thread_exit_handler &operator=(thread_exit_handler const & /*unused*/) = delete;
+    thread_exit_handler &operator=(thread_exit_handler && /*unused*/) = delete;
+};
+
+std::uint64_t thread_exit_handler::recycled_allocations = 0;
+std::uint64_t thread_exit_handler::live_allocations = 0;
+
+} // namespace
+
+TEST_CASE("handler allocations are recycled", "[handler_allocator]") {
+    auto before = dev_new::handler_allocation_counters();
+    void *ptr = dev_new::allocate_handler(100);
+    dev_new::check_allocation(ptr);
+    dev_new::deallocate_handler(ptr, 100);
+    // Same size class.
+    ptr = dev_new::allocate_handler(120);
+    dev_new::check_allocation(ptr);
+    dev_new::deallocate_handler(ptr, 120);
+
+    auto after = dev_new::handler_allocation_counters();
+    CHECK(after.allocations == before.allocations + 2);
+    CHECK(after.recycled_allocations >= before.recycled_allocations + 1);
+}
+
+TEST_CASE("recycled handler allocations are error points", "[handler_allocator]") {
+    dev_new::deallocate_handler(dev_new::allocate_handler(64), 64);
+    dev_new::set_error_countdown(1);
+    DEV_NEW_CHECK_THROWS_AS(dev_new::allocate_handler(64), std::bad_alloc);
+    DEV_NEW_END_TEST();
+}
+
+TEST_CASE("posted handlers use the handler allocator", "[handler_allocator]") {
+    asio::io_context io_context;
+    int calls = 0;
+    auto before = dev_new::handler_allocation_counters();
+    for (int i = 0; i < 3; ++i) {
+        asio::post(io_context, dev_new::bind_handler_allocator([&calls] { ++calls; }));
+        io_context.run();
+        io_context.restart();
+    }
+    auto after = dev_new::handler_allocation_counters();
+    CHECK(calls == 3);
+    CHECK(after.allocations == before.allocations + 3);
+    CHECK(after.recycled_allocations >= before.recycled_allocations + 2);
+}
+
+TEST_CASE("handler allocations after the end of the handler cache", "[handler_allocator]") {
+    auto live_before = dev_new::live_allocations();
+    std::thread([] {
+        // Constructed before the handler cache of the thread, so destroyed after it.
+        thread_local thread_exit_handler exit_handler;
+        (void)exit_handler;
+        dev_new::deallocate_handler(dev_new::allocate_handler(100), 100);
+    }).join();
+    // The allocations made after the end of the cache are not recycled.
+    CHECK(thread_exit_handler::recycled_allocations == 0);
+    CHECK(thread_exit_handler::live_allocations == live_before);
+    CHECK(dev_new::live_allocations() == live_before);
+}
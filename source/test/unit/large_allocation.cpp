@@ -0,0 +1,33 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <memory>
+#include <vector>
+
+TEST_CASE("large allocations", "[large_allocation]") {
+    auto threshold = dev_new::get_large_allocation_threshold();
+    dev_new::set_large_allocation_threshold(64 * 1024);
+    BOOST_SCOPE_EXIT_ALL(&) { dev_new::set_large_allocation_threshold(threshold); };
+
+    auto before = dev_new::large_allocation_statistics();
+    auto live_before = dev_new::live_allocations();
+    auto allocated_before = dev_new::allocated_size();
+    {
+        std::vector<char> buffer(1024 * 1024, 'a');
+        dev_new::check_allocation(buffer.data());
+        CHECK(dev_new::live_allocations() == live_before + 1);
+        CHECK(dev_new::allocated_size() == allocated_before + buffer.size());
+        CHECK(dev_new::large_allocation_statistics().live_allocations == before.live_allocations + 1);
+    }
+    CHECK(dev_new::live_allocations() == live_before);
+    CHECK(dev_new::allocated_size() == allocated_before);
+
+    // The mapping of the freed buffer is reused.
+    {
+        std::vector<char> buffer(1024 * 1024 - 100);
+        dev_new::check_allocation(buffer.data());
+    }
+    auto after = dev_new::large_allocation_statistics();
+    CHECK(after.live_allocations == before.live_allocations);
+    CHECK(after.reused_mappings == before.reused_mappings + 1);
+}
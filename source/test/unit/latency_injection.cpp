@@ -0,0 +1,112 @@
+#include "dev_new.hpp"
+#include "dev_new_asio.hpp"
+#include "dev_new_catch.hpp"
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace asio = boost::asio;
+
+namespace {
+
+// Makes count allocations of 64 bytes with a latency injection policy.
+dev_new::latency_injection_counters run_injection(dev_new::latency_injection_policy const &policy, int count) {
+    dev_new::set_latency_injection(policy);
+    for (int i = 0; i != count; ++i) {
+        dev_new::deallocate(dev_new::allocate(64));
+    }
+    dev_new::clear_latency_injection();
+    return dev_new::latency_injection_statistics();
+}
+
+} // namespace
+
+TEST_CASE("fixed latency injection", "[latency_injection]") {
+    dev_new::latency_injection_policy policy{};
+    policy.distribution = dev_new::delay_distribution::fixed;
+    policy.max_delay_nanoseconds = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    auto counters = run_injection(policy, 2);
+    auto duration = std::chrono::steady_clock::now() - start;
+    CHECK(counters.delayed_allocations == 2);
+    CHECK(counters.total_delay_nanoseconds == 2000000);
+    CHECK(duration >= std::chrono::milliseconds(2));
+
+    // Selection of the delayed allocations.
+    policy.max_delay_nanoseconds = 1;
+    policy.period = 3;
+    CHECK(run_injection(policy, 9).delayed_allocations == 3);
+    policy.period = 1;
+    policy.min_size = 65;
+    CHECK(run_injection(policy, 9).delayed_allocations == 0);
+}
+
+TEST_CASE("random latency injection", "[latency_injection]") {
+    dev_new::latency_injection_policy policy{};
+    policy.distribution = dev_new::delay_distribution::uniform;
+    policy.max_delay_nanoseconds = 1000;
+    policy.seed = 42;
+    auto first = run_injection(policy, 100);
+    CHECK(first.delayed_allocations == 100);
+    CHECK(first.max_delay_nanoseconds <= 1000);
+    // The same seed gives the same delays.
+    CHECK(run_injection(policy, 100).total_delay_nanoseconds == first.total_delay_nanoseconds);
+
+    // Recorded distribution: all the delays in the bucket of 16ns.
+    policy.distribution = dev_new::delay_distribution::recorded;
+    std::size_t bucket = 0;
+    while (dev_new::latency_bucket_lower_bound(bucket + 1) <= 16) {
+        ++bucket;
+    }
+    policy.recorded.count = 10;
+    policy.recorded.buckets.at(bucket) = 10;
+    auto recorded = run_injection(policy, 100);
+    CHECK(recorded.total_delay_nanoseconds >= 100 * dev_new::latency_bucket_lower_bound(bucket));
+    CHECK(recorded.max_delay_nanoseconds < dev_new::latency_bucket_lower_bound(bucket + 1));
+}
+
+TEST_CASE("latency recorder", "[latency_injection]") {
+    dev_new::latency_recorder recorder;
+    for (std::uint64_t value = 1; value <= 100; ++value) {
+        recorder.record(value * 1000);
+    }
+    auto histogram = recorder.histogram();
+    CHECK(histogram.count == 100);
+    CHECK(histogram.max == 100000);
+    CHECK(dev_new::latency_percentile(histogram, 0.5) <= 50000);
+    CHECK(dev_new::latency_percentile(histogram, 0.99) >= 80000);
+}
+
+TEST_CASE("handler latency", "[latency_injection]") {
+    dev_new::latency_recorder recorder;
+    int calls = 0;
+    bool in_strand = false;
+    {
+        asio::io_context io_context;
+        auto strand = asio::make_strand(io_context);
+        auto call = [&] {
+            ++calls;
+            in_strand = strand.running_in_this_thread();
+        };
+        auto handler = dev_new::bind_latency(recorder, asio::bind_executor(strand, call));
+        // The associated executor is the one of the wrapped handler.
+        CHECK(asio::get_associated_executor(handler) == strand);
+        asio::post(std::move(handler));
+        // The latency is measured from the binding.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        io_context.run();
+    }
+    CHECK(calls == 1);
+    CHECK(in_strand);
+    auto histogram = recorder.histogram();
+    CHECK(histogram.count == 1);
+    CHECK(histogram.max >= std::uint64_t{1000000});
+    CHECK(histogram.total == histogram.max);
+}
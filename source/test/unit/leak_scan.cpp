@@ -0,0 +1,129 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/predef/os.h>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if BOOST_OS_LINUX
+namespace {
+
+std::uintptr_t const hiding_mask = 0x5A5A5A5A5A5A5A5AU;
+
+// Makes allocations that are only referred to by hidden pointers (the inlining is prevented so that no copy of them is
+// left in the frame of the caller). A last allocation is made and freed so that the registers left by the call hold
+// a pointer to it rather than to a hidden allocation.
+__attribute__((noinline)) void make_hidden_allocations(std::vector<std::uintptr_t> &hidden, std::size_t count) {
+    for (std::size_t i = 0; i != count; ++i) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        hidden.push_back(reinterpret_cast<std::uintptr_t>(new std::array<char, 40>{}) ^ hiding_mask);
+    }
+    dev_new::deallocate(dev_new::allocate(40));
+}
+
+__attribute__((noinline)) void free_hidden_allocations(std::vector<std::uintptr_t> &hidden) {
+    for (auto value : hidden) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, cppcoreguidelines-owning-memory)
+        delete reinterpret_cast<std::array<char, 40> *>(value ^ hiding_mask);
+    }
+    hidden.clear();
+}
+
+// Overwrites the stack below the caller, where the previous calls may have left copies of pointers to blocks that
+// have been freed and reused since (e.g. by the hidden allocations).
+__attribute__((noinline)) void clear_stack() {
+    std::array<std::uintptr_t, 4096> words;
+    std::uintptr_t volatile *word = words.data();
+    for (std::size_t i = 0; i != words.size(); ++i) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        word[i] = 0;
+    }
+}
+
+// Checks the leak scans of the test (run in a frame of its own on a cleared stack).
+__attribute__((noinline)) void check_leak_scans() {
+    auto baseline = dev_new::find_leaks(1);
+    CHECK(baseline.complete);
+    CHECK(baseline.live_allocations > 0);
+
+    // Allocations reachable from the stack, directly or through other allocations.
+    std::vector<std::unique_ptr<int>> reachable;
+    for (int i = 0; i != 100; ++i) {
+        reachable.push_back(std::make_unique<int>(i));
+    }
+    auto with_reachable = dev_new::find_leaks(1);
+    CHECK(with_reachable.live_allocations >= baseline.live_allocations + 101);
+    CHECK(with_reachable.leaked_allocations == baseline.leaked_allocations);
+
+    std::vector<std::uintptr_t> hidden;
+    hidden.reserve(100);
+    make_hidden_allocations(hidden, 100);
+    clear_stack();
+    auto with_leaks = dev_new::find_leaks(1);
+    // The hidden allocations and the array of their hidden pointers.
+    CHECK(with_leaks.live_allocations == with_reachable.live_allocations + 101);
+    // The scan is conservative: a stale word left in a reachable allocation (e.g. by Catch) may still point to the
+    // address of a hidden allocation, reused from a block freed before. The new leaks are hidden allocations only.
+    auto new_leaks = with_leaks.leaked_allocations - with_reachable.leaked_allocations;
+    CHECK(new_leaks > 0);
+    CHECK(new_leaks <= 100);
+    CHECK(with_leaks.leaked_size - with_reachable.leaked_size == new_leaks * 40);
+    auto hidden_site = [&](dev_new::leak_site const &site) {
+        return site.allocations == new_leaks && site.size == new_leaks * 40;
+    };
+    if (dev_new::features().stack_capture) {
+        // The leaked hidden allocations are the only leaks of their call site.
+        CHECK(std::count_if(with_leaks.sites.begin(), with_leaks.sites.end(), hidden_site) == 1);
+    }
+
+    // The workers find the same leaks.
+    auto parallel = dev_new::find_leaks(4);
+    CHECK(parallel.threads == 4);
+    CHECK(parallel.leaked_allocations == with_leaks.leaked_allocations);
+    CHECK(parallel.leaked_size == with_leaks.leaked_size);
+    if (dev_new::features().stack_capture) {
+        CHECK(std::count_if(parallel.sites.begin(), parallel.sites.end(), hidden_site) == 1);
+    }
+
+    free_hidden_allocations(hidden);
+}
+
+} // namespace
+
+TEST_CASE("leak scan", "[leak_scan]") {
+    if (!dev_new::features().tracking) {
+        return;
+    }
+    clear_stack();
+    check_leak_scans();
+}
+
+TEST_CASE("leak scan with other threads", "[leak_scan]") {
+    if (!dev_new::features().tracking) {
+        return;
+    }
+    // The stack of a running thread can't be scanned.
+    std::atomic<bool> done{};
+    std::thread running([&] {
+        while (!done.load()) {
+            std::this_thread::yield();
+        }
+    });
+    auto report = dev_new::find_leaks(1);
+    done = true;
+    running.join();
+    CHECK_FALSE(report.complete);
+    CHECK(report.other_threads == 1);
+    CHECK(report.leaked_allocations == 0);
+    CHECK(report.sites.empty());
+
+    auto after = dev_new::find_leaks(1);
+    CHECK(after.complete);
+    CHECK(after.other_threads == 0);
+}
+#endif
@@ -0,0 +1,39 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+void allocate_short_lived(int count) {
+    for (int i = 0; i != count; ++i) {
+        dev_new::deallocate(dev_new::allocate(40));
+    }
+}
+
+} // namespace
+
+TEST_CASE("lifetime histograms", "[lifetime]") {
+    if (!dev_new::features().lifetimes) {
+        CHECK(dev_new::site_lifetimes().empty());
+        return;
+    }
+    auto size_class_before = dev_new::size_class_lifetimes().at(6);
+    allocate_short_lived(100);
+    auto size_class_after = dev_new::size_class_lifetimes().at(6);
+    CHECK(size_class_after.deallocations == size_class_before.deallocations + 100);
+    // No other allocation is made between the allocations and their deallocations.
+    CHECK(size_class_after.ticks.at(0) == size_class_before.ticks.at(0) + 100);
+
+    auto sites = dev_new::site_lifetimes();
+    CHECK(std::any_of(sites.begin(), sites.end(), [](auto const &site) {
+        return site.lifetimes.deallocations >= 100 && site.lifetimes.ticks.at(0) >= 100;
+    }));
+
+    auto file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    dev_new::print_lifetime_report(file);
+    CHECK(std::ftell(file) > 0);
+    std::fclose(file);
+}
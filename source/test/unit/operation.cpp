@@ -0,0 +1,72 @@
+#include "dev_new.hpp"
+#include "dev_new_asio.hpp"
+#include "dev_new_catch.hpp"
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <utility>
+
+namespace asio = boost::asio;
+
+namespace {
+
+dev_new::operation_statistics last_statistics{};
+int completed_operations = 0;
+
+void record_operation(char const * /*unused*/, dev_new::operation_statistics const &statistics) {
+    last_statistics = statistics;
+    ++completed_operations;
+}
+
+// Composed operation allocating in an intermediate step run by the associated executor of its handler.
+template <typename Handler> void async_allocate(asio::io_context &io_context, Handler &&handler) {
+    auto executor = asio::get_associated_executor(handler, io_context.get_executor());
+    asio::post(executor, [handler = std::forward<Handler>(handler)]() mutable {
+        void *buffer = dev_new::allocate(1000);
+        handler();
+        dev_new::deallocate(buffer);
+    });
+}
+
+} // namespace
+
+TEST_CASE("operation scope", "[operation]") {
+    dev_new::operation_attribution operation("operation scope");
+    void *kept = nullptr;
+    {
+        dev_new::operation_scope scope(operation);
+        kept = dev_new::allocate(sizeof(int));
+        dev_new::deallocate(dev_new::allocate(sizeof(int)));
+    }
+    void *outside = dev_new::allocate(sizeof(int));
+
+    auto statistics = operation.statistics();
+    CHECK(statistics.total_allocations == 2);
+    CHECK(statistics.total_allocated_size == 2 * sizeof(int));
+    CHECK(statistics.max_allocated_size == 2 * sizeof(int));
+    CHECK(statistics.allocated_size == sizeof(int));
+    dev_new::deallocate(kept);
+    CHECK(operation.statistics().allocated_size == 0);
+    dev_new::deallocate(outside);
+}
+
+TEST_CASE("composed operations are attributed", "[operation]") {
+    dev_new::set_operation_observer(record_operation);
+    completed_operations = 0;
+    {
+        asio::io_context io_context;
+        bool called = false;
+        async_allocate(io_context, dev_new::bind_attribution("async_allocate", [&called] {
+                           dev_new::deallocate(dev_new::allocate(sizeof(int)));
+                           called = true;
+                       }));
+        io_context.run();
+        CHECK(called);
+    }
+    dev_new::set_operation_observer(nullptr);
+
+    CHECK(completed_operations == 1);
+    CHECK(last_statistics.total_allocations >= 2);
+    CHECK(last_statistics.max_allocated_size >= 1000 + sizeof(int));
+}
@@ -0,0 +1,59 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <array>
+#include <boost/predef/os.h>
+#include <memory>
+#include <vector>
+
+#if BOOST_OS_UNIX
+#include <unistd.h>
+#endif
+
+TEST_CASE("memory overhead", "[overhead]") {
+    auto before = dev_new::overhead_statistics();
+    CHECK(before.metadata_size > 0);
+#if BOOST_OS_LINUX
+    CHECK(before.resident_size > 0);
+    CHECK(before.virtual_size >= before.resident_size);
+#endif
+
+    std::vector<std::unique_ptr<std::array<char, 20>>> allocations;
+    allocations.reserve(1000);
+    for (int i = 0; i != 1000; ++i) {
+        allocations.push_back(std::make_unique<std::array<char, 20>>());
+    }
+    auto after = dev_new::overhead_statistics();
+    CHECK(after.allocated_size >= before.allocated_size + 1000 * 20);
+    CHECK(after.header_size >= before.header_size + 1000 * sizeof(std::size_t));
+
+    // The slack of a large allocation is the rest of its last page.
+    auto threshold = dev_new::get_large_allocation_threshold();
+    void *large = dev_new::allocate(threshold + 1);
+    auto with_large = dev_new::overhead_statistics();
+    dev_new::deallocate(large);
+    CHECK(with_large.allocated_size == after.allocated_size + threshold + 1);
+    CHECK(with_large.slack_size > after.slack_size);
+}
+
+#if BOOST_OS_UNIX
+TEST_CASE("large allocation slack", "[overhead]") {
+    auto count = dev_new::get_large_allocation_threshold() + 1;
+    auto before = dev_new::overhead_statistics();
+    auto large_before = dev_new::large_allocation_statistics();
+    void *large = dev_new::allocate(count);
+    auto with_large = dev_new::overhead_statistics();
+    auto large_with = dev_new::large_allocation_statistics();
+    dev_new::deallocate(large);
+
+    REQUIRE(large_with.live_allocations == large_before.live_allocations + 1);
+    // The slack of the mappings is the part not used by the live large allocations and their headers.
+    auto header = with_large.header_size - before.header_size;
+    auto slack = with_large.slack_size - before.slack_size;
+    CHECK(slack == large_with.mapped_size - large_before.mapped_size - header - count);
+    if (large_with.reused_mappings == large_before.reused_mappings) {
+        // A new mapping: its slack is the rest of its last page.
+        CHECK(slack < static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE)));
+    }
+}
+#endif
@@ -0,0 +1,65 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+#include "dev_new_pmr.hpp"
+
+#if DEV_NEW_HAS_PMR
+
+#include <string>
+#include <vector>
+
+TEST_CASE("tracked resource statistics", "[pmr]") {
+    dev_new::tracked_resource resource;
+    {
+        std::pmr::vector<int> v(&resource);
+        v.resize(10);
+        auto statistics = resource.statistics();
+        CHECK(statistics.total_allocations == 1);
+        CHECK(statistics.live_allocations == 1);
+        CHECK(statistics.allocated_size == 10 * sizeof(int));
+    }
+    auto statistics = resource.statistics();
+    CHECK(statistics.live_allocations == 0);
+    CHECK(statistics.allocated_size == 0);
+    CHECK(statistics.max_allocated_size == 10 * sizeof(int));
+}
+
+TEST_CASE("tracked resource error testing", "[pmr]") {
+    dev_new::tracked_resource resource;
+    resource.set_error_countdown(2);
+    void *ptr = resource.allocate(8);
+    CHECK_THROWS_AS(resource.allocate(8), std::bad_alloc);
+    // Allocating beyond the size allocated when the error was raised fails.
+    resource.deallocate(ptr, 8);
+    ptr = resource.allocate(8);
+    CHECK_THROWS_AS(resource.allocate(1), std::bad_alloc);
+    resource.deallocate(ptr, 8);
+    resource.pause_error_testing();
+}
+
+TEST_CASE("over-aligned global resource allocations", "[pmr]") {
+    std::size_t const alignment = 256;
+    void *ptr = dev_new::global_resource()->allocate(10, alignment);
+    CHECK(reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0);
+    dev_new::global_resource()->deallocate(ptr, 10, alignment);
+}
+
+TEST_CASE("arena and pool stacks", "[pmr]") {
+    dev_new::tracked_monotonic_stack arena(std::size_t(1024));
+    dev_new::tracked_pool_stack pool;
+    for (auto resource : {arena.resource(), pool.resource()}) {
+        std::pmr::vector<std::pmr::string> v(resource);
+        for (int i = 0; i < 100; ++i) {
+            v.emplace_back("a string long enough not to fit the small string buffer");
+        }
+    }
+
+    CHECK(arena.front().statistics().total_allocations == pool.front().statistics().total_allocations);
+    CHECK(arena.front().statistics().live_allocations == 0);
+    CHECK(pool.front().statistics().live_allocations == 0);
+    // The arena only releases its memory when it is destroyed.
+    CHECK(arena.upstream().statistics().live_allocations != 0);
+    CHECK(arena.upstream().statistics().total_allocations < arena.front().statistics().total_allocations);
+    CHECK(pool.upstream().statistics().total_allocations < pool.front().statistics().total_allocations);
+}
+
+#endif
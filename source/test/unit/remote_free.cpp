@@ -0,0 +1,67 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST_CASE("contended deallocations of foreign pointers", "[remote_free]") {
+    if (!dev_new::features().tracking) {
+        return;
+    }
+    auto live_before = dev_new::live_allocations();
+    auto before = dev_new::remote_free_statistics();
+
+    // A pointer that isn't an allocation (in read-only memory): its deallocations are ignored, with or without
+    // contention, and never deferred. The other thread only allocates meanwhile, so nothing else can be deferred.
+    alignas(std::max_align_t) static std::array<unsigned char, 128> const foreign{};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    void *foreign_ptr = const_cast<unsigned char *>(&foreign.at(64));
+    static std::array<void *, 10000> allocated{};
+    std::atomic<bool> done{};
+    std::thread allocating([&] {
+        for (std::size_t i = 0; i != allocated.size() && !done.load(); ++i) {
+            allocated.at(i) = dev_new::allocate(64);
+        }
+    });
+    for (int i = 0; i != 10000; ++i) {
+        dev_new::deallocate(foreign_ptr);
+    }
+    done = true;
+    allocating.join();
+    CHECK(dev_new::remote_free_statistics().remote_frees == before.remote_frees);
+    for (auto &ptr : allocated) {
+        dev_new::deallocate(ptr);
+        ptr = nullptr;
+    }
+    CHECK(dev_new::live_allocations() == live_before);
+}
+
+TEST_CASE("contended deallocations are deferred", "[remote_free]") {
+    auto live_before = dev_new::live_allocations();
+    auto before = dev_new::remote_free_statistics();
+
+    // The deallocations contended by the other thread are deferred and drained by the next thread taking the lock.
+    std::atomic<bool> done{};
+    std::thread allocating([&] {
+        while (!done.load()) {
+            dev_new::deallocate(dev_new::allocate(64));
+        }
+    });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (dev_new::remote_free_statistics().remote_frees == before.remote_frees &&
+           std::chrono::steady_clock::now() < deadline) {
+        for (int i = 0; i != 1000; ++i) {
+            dev_new::deallocate(dev_new::allocate(32));
+        }
+    }
+    done = true;
+    allocating.join();
+    auto after = dev_new::remote_free_statistics();
+    CHECK(after.remote_frees > before.remote_frees);
+    CHECK(after.drained_batches > before.drained_batches);
+    CHECK(after.max_batch_size >= 1);
+
+    CHECK(dev_new::live_allocations() == live_before);
+}
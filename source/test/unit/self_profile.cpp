@@ -0,0 +1,48 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <memory>
+
+TEST_CASE("latency histogram buckets", "[self_profile]") {
+    CHECK(dev_new::latency_bucket_lower_bound(0) == 0);
+    CHECK(dev_new::latency_bucket_lower_bound(7) == 7);
+    CHECK(dev_new::latency_bucket_lower_bound(8) == 8);
+    CHECK(dev_new::latency_bucket_lower_bound(11) == 14);
+    CHECK(dev_new::latency_bucket_lower_bound(12) == 16);
+    CHECK(dev_new::latency_bucket_lower_bound(dev_new::latency_buckets - 1) == 7ULL << 61U);
+
+    dev_new::latency_histogram histogram{};
+    histogram.count = 100;
+    histogram.buckets.at(3) = 90;
+    histogram.buckets.at(12) = 10;
+    CHECK(dev_new::latency_percentile(histogram, 0.5) == 3);
+    CHECK(dev_new::latency_percentile(histogram, 0.95) == 16);
+}
+
+TEST_CASE("self profile", "[self_profile]") {
+    auto was_profiling = dev_new::is_self_profiling();
+    auto before = dev_new::self_profile();
+    dev_new::set_self_profiling(true);
+    for (int i = 0; i != 10; ++i) {
+        auto ptr = std::make_unique<int>(i);
+        dev_new::check_allocation(ptr.get());
+    }
+    dev_new::set_self_profiling(was_profiling);
+    auto after = dev_new::self_profile();
+
+    auto calls = [&](dev_new::profiled_operation operation) {
+        auto index = static_cast<std::size_t>(operation);
+        return after.operations.at(index).count - before.operations.at(index).count;
+    };
+    CHECK(calls(dev_new::profiled_operation::allocate) >= 10);
+    CHECK(calls(dev_new::profiled_operation::deallocate) >= 10);
+    CHECK(calls(dev_new::profiled_operation::check_allocation) == 10);
+    CHECK(after.ticks_per_nanosecond > 0);
+    if (dev_new::features().tracking) {
+        std::uint64_t lookups = 0;
+        for (auto count : after.probe_lengths) {
+            lookups += count;
+        }
+        CHECK(lookups >= 30);
+    }
+}
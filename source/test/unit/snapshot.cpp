@@ -0,0 +1,73 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+TEST_CASE("heap snapshot diff", "[snapshot]") {
+    if (!dev_new::features().tracking) {
+        return;
+    }
+    std::vector<std::unique_ptr<int>> kept;
+    kept.reserve(10);
+    auto before = dev_new::snapshot();
+    CHECK_FALSE(before.allocations.empty());
+    CHECK(std::is_sorted(before.allocations.begin(), before.allocations.end(),
+                         [](auto const &a, auto const &b) { return a.ptr < b.ptr; }));
+    CHECK(dev_new::diff(before, before).allocations == 0);
+
+    {
+        dev_new::category_scope category("snapshot growth");
+        for (int i = 0; i != 10; ++i) {
+            kept.push_back(std::make_unique<int>(i));
+        }
+        dev_new::deallocate(dev_new::allocate(sizeof(int)));
+    }
+    auto after = dev_new::snapshot();
+    CHECK(after.total_allocations >= before.total_allocations + 11);
+    auto growth = dev_new::diff(before, after);
+    // The buffer of the first snapshot is also allocated and not freed.
+    CHECK(growth.allocations >= 10);
+    if (dev_new::features().statistics) {
+        auto site = std::find_if(growth.sites.begin(), growth.sites.end(), [](auto const &growth_site) {
+            return std::strcmp(growth_site.category, "snapshot growth") == 0;
+        });
+        REQUIRE(site != growth.sites.end());
+        CHECK(site->allocations == 10);
+        CHECK(site->size == 10 * sizeof(int));
+    }
+
+    kept.clear();
+    auto shrink = dev_new::diff(after, dev_new::snapshot());
+    CHECK(shrink.freed_allocations >= 10);
+    CHECK(shrink.freed_size >= 10 * sizeof(int));
+}
+
+TEST_CASE("heap snapshots of arena allocations", "[snapshot]") {
+    if (!dev_new::features().tracking) {
+        return;
+    }
+    auto before = dev_new::snapshot();
+    void *kept = nullptr;
+    {
+        dev_new::arena_scope scope;
+        dev_new::category_scope category("snapshot arena growth");
+        kept = dev_new::allocate(100);
+        dev_new::deallocate(dev_new::allocate(50));
+    }
+    auto after = dev_new::snapshot();
+    CHECK(std::any_of(after.allocations.begin(), after.allocations.end(),
+                      [&](auto const &allocation) { return allocation.ptr == kept && allocation.size == 100; }));
+    if (dev_new::features().statistics) {
+        auto growth = dev_new::diff(before, after);
+        auto site = std::find_if(growth.sites.begin(), growth.sites.end(), [](auto const &growth_site) {
+            return std::strcmp(growth_site.category, "snapshot arena growth") == 0;
+        });
+        REQUIRE(site != growth.sites.end());
+        CHECK(site->allocations == 1);
+        CHECK(site->size == 100);
+    }
+    dev_new::deallocate(kept);
+}
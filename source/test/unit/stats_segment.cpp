@@ -0,0 +1,71 @@
+#include "dev_new.hpp"
+#include "dev_new_catch.hpp"
+#include "dev_new_stats_segment.hpp"
+
+#include <algorithm>
+#include <boost/predef/os.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#if BOOST_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+namespace stats_segment = dev_new::stats_segment;
+
+// Reads the statistics segment of the current process.
+bool read_segment(stats_segment::snapshot &data) {
+    auto name = stats_segment::name(static_cast<std::uint64_t>(getpid()));
+    int fd = shm_open(name.data(), O_RDONLY, 0);
+    if (fd == -1) {
+        return false;
+    }
+    void *memory = mmap(nullptr, sizeof(stats_segment::segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    bool read = stats_segment::read(*static_cast<stats_segment::segment const *>(memory), data);
+    munmap(memory, sizeof(stats_segment::segment));
+    return read;
+}
+
+} // namespace
+
+TEST_CASE("statistics segment", "[stats_segment]") {
+    REQUIRE(dev_new::publish_statistics(5));
+    {
+        dev_new::category_scope category("stats segment");
+        dev_new::deallocate(dev_new::allocate(100));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto data = std::make_unique<stats_segment::snapshot>();
+    CHECK(read_segment(*data));
+    dev_new::stop_publishing_statistics();
+    CHECK(data->pid == static_cast<std::uint64_t>(getpid()));
+    CHECK(data->publications > 1);
+    CHECK(data->total_allocations > 0);
+    // The counters are copied together.
+    CHECK(data->live_allocations <= data->total_allocations);
+    CHECK(data->allocated_size <= data->max_allocated_size);
+    CHECK(data->site_count <= stats_segment::max_sites);
+    CHECK(std::is_sorted(data->sites.begin(), data->sites.begin() + data->site_count,
+                         [](auto const &a, auto const &b) { return a.deallocations > b.deallocations; }));
+    CHECK((data->site_count != 0) == dev_new::features().lifetimes);
+    if (dev_new::features().statistics) {
+        bool found = false;
+        for (std::size_t i = 0; i != data->category_count; ++i) {
+            found = found || std::strcmp(data->categories.at(i).name.data(), "stats segment") == 0;
+        }
+        CHECK(found);
+    }
+    // The segment is removed when publishing stops.
+    CHECK_FALSE(read_segment(*data));
+}
+#endif
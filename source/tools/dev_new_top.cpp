@@ -0,0 +1,158 @@
+// Shows the statistics published by a process using dev_new (see publish_statistics()).
+//
+// Usage: dev_new_top [<pid> [<interval_ms> [<iterations>]]]
+// Without a pid, lists the processes publishing statistics.
+
+#include "dev_new_stats_segment.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+namespace stats_segment = dev_new::stats_segment;
+
+// Lists the statistics segments in /dev/shm.
+int list_segments() {
+    DIR *directory = opendir("/dev/shm");
+    if (directory == nullptr) {
+        std::perror("/dev/shm");
+        return EXIT_FAILURE;
+    }
+    char const prefix[] = "dev_new.";
+    unsigned count = 0;
+    for (dirent *entry = readdir(directory); entry != nullptr; entry = readdir(directory)) {
+        if (std::strncmp(entry->d_name, prefix, sizeof(prefix) - 1) == 0) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+            std::printf("%s\n", &entry->d_name[sizeof(prefix) - 1]);
+            ++count;
+        }
+    }
+    closedir(directory);
+    if (count == 0) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+        std::printf("no process is publishing statistics\n");
+    }
+    return EXIT_SUCCESS;
+}
+
+// Maps the statistics segment of a process (read only).
+stats_segment::segment const *open_segment(std::uint64_t pid) {
+    auto name = stats_segment::name(pid);
+    int fd = shm_open(name.data(), O_RDONLY, 0);
+    if (fd == -1) {
+        std::perror(name.data());
+        return nullptr;
+    }
+    void *memory = mmap(nullptr, sizeof(stats_segment::segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::perror(name.data());
+        return nullptr;
+    }
+    return static_cast<stats_segment::segment const *>(memory);
+}
+
+// Returns the per second rate of a counter between two snapshots.
+double rate(std::uint64_t current, std::uint64_t previous, double seconds) {
+    return seconds > 0 && current >= previous ? static_cast<double>(current - previous) / seconds : 0;
+}
+
+void print(stats_segment::snapshot const &data, stats_segment::snapshot const &previous) {
+    double seconds = static_cast<double>(data.time_nanoseconds - previous.time_nanoseconds) / 1e9;
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    // Clears the screen.
+    std::printf("\033[H\033[2J");
+    std::printf("dev_new_top - pid %" PRIu64 " - publication %" PRIu64 "\n\n", data.pid, data.publications);
+    std::printf("allocations:       %" PRIu64 " total, %" PRIu64 " live (%.0f/s)\n", data.total_allocations,
+                data.live_allocations, rate(data.total_allocations, previous.total_allocations, seconds));
+    std::printf("allocated size:    %" PRIu64 " bytes (max %" PRIu64 " bytes)\n", data.allocated_size,
+                data.max_allocated_size);
+    std::printf("lock:              %" PRIu64 " acquisitions (%.0f/s), %" PRIu64 " contended, %" PRIu64
+                " ns waiting\n",
+                data.lock_acquisitions, rate(data.lock_acquisitions, previous.lock_acquisitions, seconds),
+                data.contended_lock_acquisitions, data.lock_wait_nanoseconds);
+    std::printf("remote frees:      %" PRIu64 " (%.0f/s)\n", data.remote_frees,
+                rate(data.remote_frees, previous.remote_frees, seconds));
+    std::printf("large allocations: %" PRIu64 " live, %" PRIu64 " bytes mapped\n\n", data.large_live_allocations,
+                data.large_mapped_size);
+
+    std::printf("%-32s %12s %12s %14s %14s %12s\n", "category", "allocations", "live", "size", "max size",
+                "bytes/s");
+    auto category_count = std::min<std::uint64_t>(data.category_count, stats_segment::max_categories);
+    for (std::size_t i = 0; i != category_count; ++i) {
+        auto const &category = data.categories.at(i);
+        // The categories are sorted, so the previous counters are searched by name.
+        std::uint64_t previous_size = category.total_allocated_size;
+        for (std::size_t j = 0; j != previous.category_count; ++j) {
+            if (previous.categories.at(j).name == category.name) {
+                previous_size = previous.categories.at(j).total_allocated_size;
+            }
+        }
+        std::printf("%-32.32s %12" PRIu64 " %12" PRIu64 " %14" PRIu64 " %14" PRIu64 " %12.0f\n", category.name.data(),
+                    category.total_allocations, category.total_allocations - category.total_deallocations,
+                    category.allocated_size, category.max_allocated_size,
+                    rate(category.total_allocated_size, previous_size, seconds));
+    }
+
+    auto site_count = std::min<std::uint64_t>(data.site_count, stats_segment::max_sites);
+    if (site_count != 0) {
+        std::printf("\n%-18s %14s %18s %14s\n", "site", "deallocations", "median lifetime", "median ticks");
+        for (std::size_t i = 0; i != site_count; ++i) {
+            auto const &site = data.sites.at(i);
+            std::printf("0x%-16" PRIx64 " %14" PRIu64 " %15" PRIu64 " ns %14" PRIu64 "\n", site.address,
+                        site.deallocations, site.median_nanoseconds, site.median_ticks);
+        }
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        return list_segments();
+    }
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    auto pid = std::strtoull(argv[1], nullptr, 10);
+    auto interval = std::chrono::milliseconds(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000);
+    auto iterations = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 0;
+    // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+    auto segment = open_segment(pid);
+    if (segment == nullptr) {
+        return EXIT_FAILURE;
+    }
+    stats_segment::snapshot previous{};
+    stats_segment::snapshot data{};
+    for (unsigned long long iteration = 0; iterations == 0 || iteration != iterations; ++iteration) {
+        if (!stats_segment::read(*segment, data)) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+            std::fprintf(stderr, "invalid statistics segment of process %llu\n", pid);
+            return EXIT_FAILURE;
+        }
+        if (iteration == 0) {
+            previous = data;
+        }
+        print(data, previous);
+        previous = data;
+        std::this_thread::sleep_for(interval);
+        if (kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, hicpp-vararg)
+            std::printf("\nprocess %llu exited\n", pid);
+            break;
+        }
+    }
+    return EXIT_SUCCESS;
+}